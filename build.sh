@@ -24,10 +24,17 @@ SU=sudo
 INCLUDES="-Isrc/kernel \
 -Isrc/kernel/shell \
 -Isrc/kernel/ramdisk \
+-Isrc/kernel/interrupts \
+-Isrc/kernel/bench \
+-Isrc/kernel/latency \
 -Isrc/drivers \
 -Isrc/drivers/vga \
 -Isrc/drivers/keyboard \
+-Isrc/drivers/timer \
+-Isrc/drivers/serial \
 -Isrc/libraries/string \
+-Isrc/libraries/div64 \
+-Isrc/libraries/kprintf \
 -Isrc/calc \
 -Isrc/rtc \
 -Isrc/banner"
@@ -45,19 +52,31 @@ GRUB_DIR="$BOOT_DIR/grub"
 
 KERNEL="$BUILD_DIR/kernel.elf"
 ISO="cdos.iso"
+BENCH_ISO="cdos-bench.iso"
 GRUB_CFG=src/boot/grub.cfg
+BENCH_GRUB_CFG=src/boot/grub-bench.cfg
+BENCH_OUTPUT=bench_output.txt
+BENCH_TIMEOUT=300
 
 OBJS=(
   "$BUILD_DIR/boot.o"
   "$BUILD_DIR/kernel.o"
+  "$BUILD_DIR/isr.o"
+  "$BUILD_DIR/interrupts.o"
   "$BUILD_DIR/shell.o"
+  "$BUILD_DIR/bench.o"
+  "$BUILD_DIR/latency.o"
   "$BUILD_DIR/vga.o"
   "$BUILD_DIR/keyboard.o"
+  "$BUILD_DIR/timer.o"
+  "$BUILD_DIR/serial.o"
   "$BUILD_DIR/ramdisk.o"
   "$BUILD_DIR/calc.o"
   "$BUILD_DIR/string.o"
+  "$BUILD_DIR/kprintf.o"
   "$BUILD_DIR/rtc.o"
   "$BUILD_DIR/banner.o"
+  "$BUILD_DIR/workload.o"
 )
 
 build_object() {
@@ -74,17 +93,27 @@ function build {
   mkdir -p "$BUILD_DIR"
 
   $AS --32 -o "$BUILD_DIR/boot.o" src/boot/boot.S
+  $AS --32 -o "$BUILD_DIR/isr.o" src/kernel/interrupts/isr.S
   build_object src/kernel/kernel.c "$BUILD_DIR/kernel.o"
+  build_object src/kernel/interrupts/interrupts.c "$BUILD_DIR/interrupts.o"
   build_object src/kernel/shell/shell.c "$BUILD_DIR/shell.o"
+  build_object src/kernel/bench/bench.c "$BUILD_DIR/bench.o"
+  build_object src/kernel/latency/latency.c "$BUILD_DIR/latency.o"
   build_object src/drivers/vga/vga.c "$BUILD_DIR/vga.o"
   build_object src/drivers/keyboard/keyboard.c "$BUILD_DIR/keyboard.o"
+  build_object src/drivers/timer/timer.c "$BUILD_DIR/timer.o"
+  build_object src/drivers/serial/serial.c "$BUILD_DIR/serial.o"
   build_object src/kernel/ramdisk/ramdisk.c "$BUILD_DIR/ramdisk.o"
   build_object src/calc/calc.c "$BUILD_DIR/calc.o"
   build_object src/libraries/string/string.c "$BUILD_DIR/string.o"
+  build_object src/libraries/kprintf/kprintf.c "$BUILD_DIR/kprintf.o"
   build_object src/rtc/rtc.c "$BUILD_DIR/rtc.o"
 
+  $CC -O2 -Wall -Wextra -Isrc/drivers/vga -o "$BUILD_DIR/bannergen" src/banner/bannergen.c
+  "$BUILD_DIR/bannergen" src/banner/banner.txt "$BUILD_DIR/banner.bin"
+  (cd "$BUILD_DIR" && objcopy -I binary -O elf32-i386 -B i386 banner.bin banner.o)
   objcopy -I binary -O elf32-i386 -B i386 \
-    src/banner/banner.txt "$BUILD_DIR/banner.o"
+    src/kernel/bench/workload.txt "$BUILD_DIR/workload.o"
 
   $LD $LDFLAGS -o "$KERNEL" "${OBJS[@]}"
   strip -sv "$KERNEL"
@@ -99,11 +128,53 @@ function build {
     -o "$ISO" \
     "$ISO_DIR"
 
+  cp "$BENCH_GRUB_CFG" "$GRUB_DIR/grub.cfg"
+  grub-mkrescue \
+    --directory=/usr/lib/grub/i386-pc \
+    --install-modules="multiboot" \
+    -o "$BENCH_ISO" \
+    "$ISO_DIR"
+
   rm -rf "$BUILD_DIR"
 }
 
 function run {
-  qemu-system-i386 -drive file="$ISO",format=raw -m 3M -cpu 486
+  qemu-system-i386 -drive file="$ISO",format=raw -m 3M -cpu 486 -serial stdio
+}
+
+function bench {
+  if [ ! -f "$BENCH_ISO" ] || [ -n "$(find src build.sh -newer "$BENCH_ISO" -print -quit)" ]; then
+    all
+  fi
+
+  local raw
+  raw=$(mktemp)
+  local start end status
+  start=$(date +%s%N)
+  set +e
+  timeout "$BENCH_TIMEOUT" qemu-system-i386 \
+    -drive file="$BENCH_ISO",format=raw -m 3M -cpu pentium \
+    -display none -monitor none -no-reboot \
+    -serial file:"$raw" \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04
+  status=$?
+  set -e
+  end=$(date +%s%N)
+
+  {
+    echo "commit: $(git rev-parse --short HEAD 2>/dev/null || echo unknown)"
+    echo "host wall time: $(( (end - start) / 1000000 )) ms"
+    sed -e 's/\x1b\[[0-9;]*[A-Za-z]//g' -e 's/\r//g' "$raw"
+  } > "$BENCH_OUTPUT"
+  rm -f "$raw"
+
+  cat "$BENCH_OUTPUT"
+  case $status in
+    1) echo "Benchmark passed, results in $BENCH_OUTPUT"; return 0 ;;
+    3) echo "Benchmark workload had failing commands" >&2; return 1 ;;
+    124) echo "Benchmark timed out after ${BENCH_TIMEOUT}s" >&2; return 1 ;;
+    *) echo "QEMU exited with status $status" >&2; return 1 ;;
+  esac
 }
 
 function write {
@@ -140,7 +211,7 @@ function burn {
 }
 
 function clean {
-  rm -rf "$BUILD_DIR" "$ISO"
+  rm -rf "$BUILD_DIR" "$ISO" "$BENCH_ISO"
 }
 
 case "$1" in
@@ -148,9 +219,10 @@ case "$1" in
   all) all ;;
   build) build ;;
   run) run ;;
+  bench) bench ;;
   write) write ;;
   deps) deps ;;
   burn) burn ;;
   clean) clean ;;
-  *) echo "Usage: $0 {all|build|run|write|clean|deps|burn}" ;;
+  *) echo "Usage: $0 {all|build|run|bench|write|clean|deps|burn}" ;;
 esac
\ No newline at end of file
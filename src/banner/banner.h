@@ -21,8 +21,9 @@
 
 #include <stdint.h>
 
-extern const uint8_t _binary_src_banner_banner_txt_start[];
-extern const uint8_t _binary_src_banner_banner_txt_end[];
-extern const uint32_t _binary_src_banner_banner_txt_size;
+#define BANNER_WIDTH 80
+
+extern const uint16_t _binary_banner_bin_start[];
+extern const uint16_t _binary_banner_bin_end[];
 
 #endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host tool run by build.sh: renders banner.txt, including its ANSI colour
+ * escapes, into little-endian VGA text cells so the kernel can copy the
+ * banner straight to the screen.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "sgr.h"
+
+#define SCREEN_WIDTH 80
+#define SCREEN_HEIGHT 25
+
+static uint16_t cells[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s banner.txt banner.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t fg = 0xF, bg = 0x0;
+    int x = 0, y = 0, rows = 0;
+    int c;
+
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) cells[i] = ' ' | 0x0F00;
+
+    while ((c = fgetc(in)) != EOF) {
+        if (c == '\033') {
+            int params[8] = {0};
+            int count = 0;
+            if ((c = fgetc(in)) != '[') continue;
+            while ((c = fgetc(in)) != EOF && ((c >= '0' && c <= '9') || c == ';')) {
+                if (c == ';') {
+                    if (count < 7) count++;
+                } else {
+                    params[count] = params[count] * 10 + (c - '0');
+                }
+            }
+            if (c == 'm') {
+                for (int i = 0; i <= count; i++) sgr_apply(params[i], &fg, &bg);
+            }
+            continue;
+        }
+
+        if (c == '\r') continue;
+        if (c == '\n') {
+            x = 0;
+            y++;
+            continue;
+        }
+        if (y >= SCREEN_HEIGHT) {
+            fprintf(stderr, "%s: banner is taller than %d rows\n", argv[1], SCREEN_HEIGHT);
+            fclose(in);
+            return 1;
+        }
+        cells[y * SCREEN_WIDTH + x] = (uint16_t)((uint8_t)c | (((bg << 4) | fg) << 8));
+        if (y + 1 > rows) rows = y + 1;
+        if (++x >= SCREEN_WIDTH) {
+            x = 0;
+            y++;
+        }
+    }
+    fclose(in);
+    if (y > rows) rows = y > SCREEN_HEIGHT ? SCREEN_HEIGHT : y;
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    for (int i = 0; i < rows * SCREEN_WIDTH; i++) {
+        fputc(cells[i] & 0xFF, out);
+        fputc(cells[i] >> 8, out);
+    }
+    fclose(out);
+    return 0;
+}
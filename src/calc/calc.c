@@ -19,28 +19,65 @@
 #include "calc.h"
 #include "string.h"
 #include "vga.h"
+#include "div64.h"
+#include <stddef.h>
 #include <stdint.h>
 
-#define MAX_DIGITS 128
+#define CALC_ARENA_LIMBS 32768
+#define KARATSUBA_THRESHOLD 32
+#define CHUNK_BASE 1000000000u
+#define CHUNK_DIGITS 9
+#define POW10_CACHED 8
+#define POW10_LEVELS 24
+#define PARSE_DC_THRESHOLD 600
+#define PRINT_DC_THRESHOLD 40
+#define CALC_VARS 8
+#define CALC_NAME_MAX 8
+#define CALC_VAR_LIMBS 4096
+#define CALC_CACHE_ENTRIES 4
+#define CALC_EXPR_MAX 256
+#define CALC_CODE_MAX 256
+#define CALC_CONST_MAX 64
+#define CALC_CONST_LIMBS (CALC_EXPR_MAX / CHUNK_DIGITS + CALC_CONST_MAX)
+#define CALC_STACK_MAX 32
+#define CALC_NESTING_MAX 32
 
+/*
+ * Limbs live in calc_arena and are sized to the value. A built value is
+ * never modified, so copies and sign flips share the limbs.
+ */
 typedef struct {
-    uint32_t digits[MAX_DIGITS];
+    uint32_t *digits;
     int size;
     int sign;
 } big32_t;
 
-static void big32_add(const big32_t* a, const big32_t* b, big32_t* result);
+static uint32_t calc_arena[CALC_ARENA_LIMBS];
+static int arena_top;
+
+static void pow10_release(void);
+
+static uint32_t *arena_alloc(int limbs) {
+    if (limbs > CALC_ARENA_LIMBS - arena_top) return NULL;
+    uint32_t *p = calc_arena + arena_top;
+    arena_top += limbs;
+    return p;
+}
+
+static void arena_reset(void) {
+    arena_top = 0;
+    pow10_release();
+}
 
 static void big32_zero(big32_t* num) {
-    for (int i = 0; i < MAX_DIGITS; i++) num->digits[i] = 0;
+    num->digits = NULL;
     num->size = 0;
     num->sign = 1;
 }
 
-static void big32_copy(const big32_t* src, big32_t* dest) {
-    for (int i = 0; i < MAX_DIGITS; i++) dest->digits[i] = src->digits[i];
-    dest->size = src->size;
-    dest->sign = src->sign;
+static void big32_trim(big32_t* num) {
+    while (num->size > 0 && num->digits[num->size - 1] == 0) num->size--;
+    if (num->size == 0) num->sign = 1;
 }
 
 static int big32_compare(const big32_t* a, const big32_t* b) {
@@ -52,223 +89,1273 @@ static int big32_compare(const big32_t* a, const big32_t* b) {
     return 0;
 }
 
-static void big32_parse(big32_t* num, const char* str) {
-    big32_zero(num);
-    int len = (int)kstrlen(str);
-    int i = 0;
-    if (str[0] == '-') {
-        num->sign = -1;
-        i = 1;
-    }
-    for (; i < len; i++) {
-        char c = str[i];
-        if (c >= '0' && c <= '9') {
-            uint32_t carry = c - '0';
-            for (int j = 0; j < num->size || carry; j++) {
-                if (j == num->size) num->digits[num->size++] = 0;
-                uint64_t val = (uint64_t)num->digits[j] * 10 + carry;
-                num->digits[j] = (uint32_t)(val & 0xFFFFFFFF);
-                carry = (uint32_t)(val >> 32);
-            }
+/*
+ * Limb-array routines. Arrays are little-endian and sized by the caller;
+ * products always get an + bn limbs.
+ */
+static uint32_t limbs_add_n(uint32_t *r, const uint32_t *a, const uint32_t *b, int n) {
+    uint32_t carry = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t sum = (uint64_t)a[i] + b[i] + carry;
+        r[i] = (uint32_t)sum;
+        carry = (uint32_t)(sum >> 32);
+    }
+    return carry;
+}
+
+static uint32_t limbs_sub_n(uint32_t *r, const uint32_t *a, const uint32_t *b, int n) {
+    uint32_t borrow = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t diff = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)diff;
+        borrow = (uint32_t)(diff >> 63);
+    }
+    return borrow;
+}
+
+/* r = a + b where an >= bn; r may alias a. */
+static uint32_t limbs_add(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn) {
+    uint32_t carry = limbs_add_n(r, a, b, bn);
+    for (int i = bn; i < an; i++) {
+        uint64_t sum = (uint64_t)a[i] + carry;
+        r[i] = (uint32_t)sum;
+        carry = (uint32_t)(sum >> 32);
+    }
+    return carry;
+}
+
+/* r = a - b where an >= bn; r may alias a. */
+static uint32_t limbs_sub(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn) {
+    uint32_t borrow = limbs_sub_n(r, a, b, bn);
+    for (int i = bn; i < an; i++) {
+        uint64_t diff = (uint64_t)a[i] - borrow;
+        r[i] = (uint32_t)diff;
+        borrow = (uint32_t)(diff >> 63);
+    }
+    return borrow;
+}
+
+static void limbs_mul_basecase(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn) {
+    for (int i = 0; i < an + bn; i++) r[i] = 0;
+    for (int i = 0; i < an; i++) {
+        uint64_t ai = a[i];
+        uint32_t carry = 0;
+        if (ai == 0) continue;
+        for (int j = 0; j < bn; j++) {
+            uint64_t t = ai * b[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)t;
+            carry = (uint32_t)(t >> 32);
         }
+        r[i + bn] = carry;
     }
 }
 
-static void big32_print(const big32_t* num) {
-    big32_t tmp;
-    big32_copy(num, &tmp);
-    char buf[MAX_DIGITS * 10];
-    int idx = 0;
-    if (tmp.size == 0 || (tmp.size == 1 && tmp.digits[0] == 0)) {
-        putchar('0');
-        print("\n");
+/* Each cross product a[i]*a[j] is computed once and doubled, then the
+ * squares of the limbs are added on the diagonal. */
+static void limbs_sqr_basecase(uint32_t *r, const uint32_t *a, int n) {
+    for (int i = 0; i < 2 * n; i++) r[i] = 0;
+    for (int i = 0; i < n - 1; i++) {
+        uint64_t ai = a[i];
+        uint32_t carry = 0;
+        for (int j = i + 1; j < n; j++) {
+            uint64_t t = ai * a[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)t;
+            carry = (uint32_t)(t >> 32);
+        }
+        r[i + n] = carry;
+    }
+
+    uint32_t top = 0;
+    for (int i = 0; i < 2 * n; i++) {
+        uint32_t next = r[i] >> 31;
+        r[i] = (r[i] << 1) | top;
+        top = next;
+    }
+
+    uint32_t carry = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t sq = (uint64_t)a[i] * a[i];
+        uint64_t lo = (uint64_t)r[2 * i] + (uint32_t)sq + carry;
+        uint64_t hi = (uint64_t)r[2 * i + 1] + (uint32_t)(sq >> 32) + (lo >> 32);
+        r[2 * i] = (uint32_t)lo;
+        r[2 * i + 1] = (uint32_t)hi;
+        carry = (uint32_t)(hi >> 32);
+    }
+}
+
+/*
+ * Karatsuba on two n-limb operands split as x = x1*B^l + x0:
+ * x*y = z2*B^2l + ((x0+x1)(y0+y1) - z2 - z0)*B^l + z0.
+ * tmp needs about 4n limbs across all levels of the recursion.
+ */
+static void limbs_mul_n(uint32_t *r, const uint32_t *a, const uint32_t *b, int n, uint32_t *tmp) {
+    if (n < KARATSUBA_THRESHOLD) {
+        limbs_mul_basecase(r, a, n, b, n);
         return;
     }
-    while (tmp.size > 0) {
-        uint32_t rem = 0;
-        for (int i = tmp.size - 1; i >= 0; i--) {
-            uint64_t val = ((uint64_t)rem << 32) | tmp.digits[i];
-            tmp.digits[i] = (uint32_t)(val / 10);
-            rem = (uint32_t)(val % 10);
-        }
-        buf[idx++] = '0' + rem;
-        while (tmp.size > 0 && tmp.digits[tmp.size - 1] == 0) tmp.size--;
+    int l = n / 2;
+    int h = n - l;
+    uint32_t *sa = tmp;
+    uint32_t *sb = sa + h + 1;
+    uint32_t *z1 = sb + h + 1;
+    uint32_t *next = z1 + 2 * (h + 1);
+
+    limbs_mul_n(r, a, b, l, next);
+    limbs_mul_n(r + 2 * l, a + l, b + l, h, next);
+
+    sa[h] = limbs_add(sa, a + l, h, a, l);
+    sb[h] = limbs_add(sb, b + l, h, b, l);
+    limbs_mul_n(z1, sa, sb, h + 1, next);
+    limbs_sub(z1, z1, 2 * (h + 1), r, 2 * l);
+    limbs_sub(z1, z1, 2 * (h + 1), r + 2 * l, 2 * h);
+    limbs_add(r + l, r + l, 2 * n - l, z1, 2 * h + 1 < 2 * n - l ? 2 * h + 1 : 2 * n - l);
+}
+
+static void limbs_sqr_n(uint32_t *r, const uint32_t *a, int n, uint32_t *tmp) {
+    if (n < KARATSUBA_THRESHOLD) {
+        limbs_sqr_basecase(r, a, n);
+        return;
     }
-    if (num->sign == -1) putchar('-');
-    for (int i = idx - 1; i >= 0; i--) putchar(buf[i]);
-    print("\n");
+    int l = n / 2;
+    int h = n - l;
+    uint32_t *sa = tmp;
+    uint32_t *z1 = sa + h + 1;
+    uint32_t *next = z1 + 2 * (h + 1);
+
+    limbs_sqr_n(r, a, l, next);
+    limbs_sqr_n(r + 2 * l, a + l, h, next);
+
+    sa[h] = limbs_add(sa, a + l, h, a, l);
+    limbs_sqr_n(z1, sa, h + 1, next);
+    limbs_sub(z1, z1, 2 * (h + 1), r, 2 * l);
+    limbs_sub(z1, z1, 2 * (h + 1), r + 2 * l, 2 * h);
+    limbs_add(r + l, r + l, 2 * n - l, z1, 2 * h + 1 < 2 * n - l ? 2 * h + 1 : 2 * n - l);
 }
 
-static void big32_sub(const big32_t* a, const big32_t* b, big32_t* result) {
-    if (a->sign != b->sign) {
-        big32_t t = *b;
-        t.sign *= -1;
-        big32_add(a, &t, result);
+/* r = a * b with an >= bn. Operands of different lengths are multiplied
+ * in bn-limb slices of a so every Karatsuba call is balanced. */
+static void limbs_mul(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn, uint32_t *tmp) {
+    if (bn < KARATSUBA_THRESHOLD) {
+        limbs_mul_basecase(r, a, an, b, bn);
+        return;
+    }
+    if (an == bn) {
+        limbs_mul_n(r, a, b, bn, tmp);
         return;
     }
+
+    uint32_t *slice = tmp;
+    int done = 0;
+    for (int i = 0; i < an + bn; i++) r[i] = 0;
+    while (done < an) {
+        int len = an - done < bn ? an - done : bn;
+        if (len == bn) limbs_mul_n(slice, a + done, b, bn, slice + 2 * bn);
+        else limbs_mul_basecase(slice, b, bn, a + done, len);
+        limbs_add(r + done, r + done, an + bn - done, slice, len + bn);
+        done += len;
+    }
+}
+
+
+static int mul_tmp_limbs(int n) {
+    return 6 * n + 128;
+}
+
+/* result = a + bsign * |b|; subtraction passes the flipped sign in. */
+static int big32_add_signed(const big32_t* a, const big32_t* b, int bsign, big32_t* result) {
+    const big32_t *x = a;
+    const big32_t *y = b;
+    int xsign = a->sign;
+    int ysign = bsign;
     if (big32_compare(a, b) < 0) {
-        big32_sub(b, a, result);
-        result->sign = -1;
+        x = b;
+        y = a;
+        xsign = bsign;
+        ysign = a->sign;
+    }
+
+    uint32_t *d = arena_alloc(x->size + 1);
+    if (!d) return -1;
+    if (xsign == ysign) {
+        d[x->size] = limbs_add(d, x->digits, x->size, y->digits, y->size);
+        result->size = x->size + 1;
+    } else {
+        limbs_sub(d, x->digits, x->size, y->digits, y->size);
+        result->size = x->size;
+    }
+    result->digits = d;
+    result->sign = xsign;
+    big32_trim(result);
+    return 0;
+}
+
+static int big32_add(const big32_t* a, const big32_t* b, big32_t* result) {
+    return big32_add_signed(a, b, b->sign, result);
+}
+
+static int big32_sub(const big32_t* a, const big32_t* b, big32_t* result) {
+    return big32_add_signed(a, b, -b->sign, result);
+}
+
+static int big32_mul(const big32_t* a, const big32_t* b, big32_t* result) {
+    if (a->size < b->size) {
+        const big32_t *t = a;
+        a = b;
+        b = t;
+    }
+    int sign = a->sign * b->sign;
+    if (b->size == 0) {
+        big32_zero(result);
+        return 0;
+    }
+
+    uint32_t *d = arena_alloc(a->size + b->size);
+    if (!d) return -1;
+    int mark = arena_top;
+    uint32_t *tmp = arena_alloc(mul_tmp_limbs(b->size));
+    if (!tmp) return -1;
+    if (a == b || (a->size == b->size && big32_compare(a, b) == 0)) {
+        limbs_sqr_n(d, a->digits, a->size, tmp);
+    } else {
+        limbs_mul(d, a->digits, a->size, b->digits, b->size, tmp);
+    }
+    arena_top = mark;
+
+    result->digits = d;
+    result->size = a->size + b->size;
+    result->sign = sign;
+    big32_trim(result);
+    return 0;
+}
+
+/* q = a / d for a single-limb divisor; returns the remainder. */
+static uint32_t limbs_divmod_1(uint32_t *q, const uint32_t *a, int n, uint32_t d) {
+    uint32_t rem = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        q[i] = (uint32_t)udiv64_32(((uint64_t)rem << 32) | a[i], d, &rem);
+    }
+    return rem;
+}
+
+/*
+ * Knuth's Algorithm D (TAOCP 4.3.1). The divisor is shifted so its top
+ * bit is set, which keeps each estimated quotient limb at most two above
+ * the true one. Needs m >= n >= 2; q gets m - n + 1 limbs, r gets n and
+ * tmp m + n + 1.
+ */
+static void limbs_divmod(uint32_t *q, uint32_t *r, const uint32_t *u, int m, const uint32_t *v, int n, uint32_t *tmp) {
+    int shift = __builtin_clz(v[n - 1]);
+    uint32_t *un = tmp;
+    uint32_t *vn = tmp + m + 1;
+
+    if (shift) {
+        for (int i = n - 1; i > 0; i--) vn[i] = (v[i] << shift) | (v[i - 1] >> (32 - shift));
+        vn[0] = v[0] << shift;
+        un[m] = u[m - 1] >> (32 - shift);
+        for (int i = m - 1; i > 0; i--) un[i] = (u[i] << shift) | (u[i - 1] >> (32 - shift));
+        un[0] = u[0] << shift;
+    } else {
+        for (int i = 0; i < n; i++) vn[i] = v[i];
+        for (int i = 0; i < m; i++) un[i] = u[i];
+        un[m] = 0;
+    }
+
+    uint32_t vtop = vn[n - 1];
+    uint32_t vnext = vn[n - 2];
+    for (int j = m - n; j >= 0; j--) {
+        uint32_t rem;
+        uint64_t qhat = udiv64_32(((uint64_t)un[j + n] << 32) | un[j + n - 1], vtop, &rem);
+        uint64_t rhat = rem;
+        while (qhat >> 32 || qhat * vnext > ((rhat << 32) | un[j + n - 2])) {
+            qhat--;
+            rhat += vtop;
+            if (rhat >> 32) break;
+        }
+
+        uint32_t carry = 0;
+        uint32_t borrow = 0;
+        for (int i = 0; i < n; i++) {
+            uint64_t p = qhat * vn[i] + carry;
+            carry = (uint32_t)(p >> 32);
+            uint64_t t = (uint64_t)un[i + j] - (uint32_t)p - borrow;
+            un[i + j] = (uint32_t)t;
+            borrow = (uint32_t)(t >> 32) ? 1 : 0;
+        }
+        uint64_t t = (uint64_t)un[j + n] - carry - borrow;
+        un[j + n] = (uint32_t)t;
+
+        if (t >> 32) {
+            qhat--;
+            un[j + n] += limbs_add_n(un + j, un + j, vn, n);
+        }
+        q[j] = (uint32_t)qhat;
+    }
+
+    if (shift) {
+        for (int i = 0; i < n - 1; i++) r[i] = (un[i] >> shift) | (un[i + 1] << (32 - shift));
+        r[n - 1] = un[n - 1] >> shift;
+    } else {
+        for (int i = 0; i < n; i++) r[i] = un[i];
+    }
+}
+
+static int big32_divmod(const big32_t* a, const big32_t* b, big32_t* quotient, big32_t* remainder) {
+    int qsign = a->sign * b->sign;
+    int rsign = a->sign;
+    int m = a->size;
+    int n = b->size;
+
+    if (big32_compare(a, b) < 0) {
+        *remainder = *a;
+        big32_zero(quotient);
+        return 0;
+    }
+
+    uint32_t *q = arena_alloc(m - n + 1);
+    uint32_t *r = arena_alloc(n);
+    if (!q || !r) return -1;
+    if (n == 1) {
+        r[0] = limbs_divmod_1(q, a->digits, m, b->digits[0]);
+    } else {
+        int mark = arena_top;
+        uint32_t *tmp = arena_alloc(m + n + 1);
+        if (!tmp) return -1;
+        limbs_divmod(q, r, a->digits, m, b->digits, n, tmp);
+        arena_top = mark;
+    }
+
+    quotient->digits = q;
+    quotient->size = m - n + 1;
+    quotient->sign = qsign;
+    remainder->digits = r;
+    remainder->size = n;
+    remainder->sign = rsign;
+    big32_trim(quotient);
+    big32_trim(remainder);
+    return 0;
+}
+
+static int limbs_bit(const uint32_t *a, int bit) {
+    return (a[bit / 32] >> (bit % 32)) & 1;
+}
+
+static int limbs_bits(const uint32_t *a, int n) {
+    return n ? (n - 1) * 32 + 32 - __builtin_clz(a[n - 1]) : 0;
+}
+
+/* Upper bound on log2 of a, in 1/65536ths of a bit, taken from its top
+ * 16 bits: a < (top + 1) * 2^(bits - 16). The fraction comes from repeated
+ * squaring in 2.30 fixed point and is padded for truncation. */
+static uint32_t limbs_log2_bound(const uint32_t *a, int n) {
+    int bits = limbs_bits(a, n);
+    int shift = bits > 16 ? bits - 16 : 0;
+    uint32_t m = 0;
+    for (int i = bits - 1; i >= shift; i--) m = m << 1 | (uint32_t)limbs_bit(a, i);
+    if (shift) m++;
+
+    int whole = 31 - __builtin_clz(m);
+    uint64_t x = (uint64_t)m << (30 - whole);
+    uint32_t frac = 0;
+    for (int i = 15; i >= 0; i--) {
+        x = (x * x) >> 30;
+        if (x >= (2ULL << 30)) {
+            x >>= 1;
+            frac |= 1u << i;
+        }
+    }
+    return ((uint32_t)(shift + whole) << 16) + frac + 2;
+}
+
+/* result = a^e; the result size is bounded up front from e * log2(a) so the
+ * squarings can ping-pong between two buffers. */
+static int big32_pow(const big32_t* a, const big32_t* e, big32_t* result) {
+    int odd = e->size && (e->digits[0] & 1);
+    if (a->size == 0 || (a->size == 1 && a->digits[0] == 1) || e->size == 0) {
+        uint32_t *d = arena_alloc(1);
+        if (!d) return -1;
+        d[0] = 1;
+        result->digits = d;
+        result->size = e->size == 0 || a->size != 0;
+        result->sign = a->sign < 0 && odd ? -1 : 1;
+        big32_trim(result);
+        return 0;
+    }
+    if (e->size > 1) return -1;
+
+    uint32_t exp = e->digits[0];
+    if ((uint64_t)(limbs_bits(a->digits, a->size) - 1) * exp > (uint64_t)CALC_ARENA_LIMBS * 32) return -1;
+    uint64_t bits = (((uint64_t)limbs_log2_bound(a->digits, a->size) * exp) >> 16) + 1;
+    int cap = (int)(bits / 32) + 2;
+    uint32_t *x = arena_alloc(cap);
+    uint32_t *y = arena_alloc(cap);
+    uint32_t *tmp = arena_alloc(mul_tmp_limbs(cap));
+    if (!x || !y || !tmp) return -1;
+
+    int xn = a->size;
+    for (int i = 0; i < xn; i++) x[i] = a->digits[i];
+    for (int i = 30 - __builtin_clz(exp); i >= 0; i--) {
+        uint32_t *t;
+        limbs_sqr_n(y, x, xn, tmp);
+        xn *= 2;
+        while (y[xn - 1] == 0) xn--;
+        t = x;
+        x = y;
+        y = t;
+        if ((exp >> i) & 1) {
+            limbs_mul(y, x, xn, a->digits, a->size, tmp);
+            xn += a->size;
+            while (y[xn - 1] == 0) xn--;
+            t = x;
+            x = y;
+            y = t;
+        }
+    }
+
+    result->digits = x;
+    result->size = xn;
+    result->sign = a->sign < 0 && odd ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Modular multiply for powmod. Odd moduli use Montgomery form, where
+ * REDC replaces the division by m with n single-limb multiply-adds;
+ * even moduli fall back to Algorithm D on the full product.
+ */
+typedef struct {
+    const uint32_t *m;
+    int n;
+    int montgomery;
+    uint32_t minv;  /* -m^-1 mod 2^32 */
+    uint32_t *product;
+    uint32_t *quotient;
+    uint32_t *mul_tmp;
+    uint32_t *div_tmp;
+} modmul_t;
+
+static void mod_mul(modmul_t *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    int n = ctx->n;
+    uint32_t *t = ctx->product;
+    if (a == b) limbs_sqr_n(t, a, n, ctx->mul_tmp);
+    else limbs_mul_n(t, a, b, n, ctx->mul_tmp);
+    t[2 * n] = 0;
+
+    if (!ctx->montgomery) {
+        if (n == 1) r[0] = limbs_divmod_1(ctx->quotient, t, 2, ctx->m[0]);
+        else limbs_divmod(ctx->quotient, r, t, 2 * n, ctx->m, n, ctx->div_tmp);
         return;
     }
-    big32_zero(result);
-    result->sign = a->sign;
-    int borrow = 0;
-    for (int i = 0; i < a->size; i++) {
-        int64_t x = a->digits[i];
-        int64_t y = (i < b->size) ? b->digits[i] : 0;
-        int64_t diff = x - y - borrow;
-        if (diff < 0) {
-            diff += (1LL << 32);
-            borrow = 1;
+
+    for (int i = 0; i < n; i++) {
+        uint32_t u = t[i] * ctx->minv;
+        uint32_t carry = 0;
+        for (int j = 0; j < n; j++) {
+            uint64_t p = (uint64_t)u * ctx->m[j] + t[i + j] + carry;
+            t[i + j] = (uint32_t)p;
+            carry = (uint32_t)(p >> 32);
+        }
+        for (int k = i + n; carry; k++) {
+            uint64_t s = (uint64_t)t[k] + carry;
+            t[k] = (uint32_t)s;
+            carry = (uint32_t)(s >> 32);
+        }
+    }
+    int ge = t[2 * n] != 0;
+    if (!ge) {
+        int i = n - 1;
+        while (i >= 0 && t[n + i] == ctx->m[i]) i--;
+        ge = i < 0 || t[n + i] > ctx->m[i];
+    }
+    if (ge) limbs_sub_n(r, t + n, ctx->m, n);
+    else for (int i = 0; i < n; i++) r[i] = t[n + i];
+}
+
+static int window_bits(int bits) {
+    if (bits <= 8) return 1;
+    if (bits <= 24) return 2;
+    if (bits <= 80) return 3;
+    if (bits <= 240) return 4;
+    if (bits <= 672) return 5;
+    return 6;
+}
+
+/* r = |a|^e mod |m| by left-to-right sliding windows over the odd powers
+ * a, a^3, ..., a^(2^w - 1); negative a gives a negative result for odd e,
+ * matching (a ^ e) % m. */
+static int big32_powmod(const big32_t* a, const big32_t* e, const big32_t* m, big32_t* result) {
+    int n = m->size;
+    big32_t base;
+    big32_t q;
+    big32_t ma = {a->digits, a->size, 1};
+    big32_t mm = {m->digits, m->size, 1};
+    if (big32_divmod(&ma, &mm, &q, &base) != 0) return -1;
+
+    uint32_t *acc = arena_alloc(n);
+    if (!acc) return -1;
+    result->digits = acc;
+    result->size = n;
+    result->sign = a->sign < 0 && e->size && (e->digits[0] & 1) ? -1 : 1;
+    for (int i = 0; i < n; i++) acc[i] = 0;
+    if (n == 1 && m->digits[0] == 1) {
+        big32_trim(result);
+        return 0;
+    }
+    if (e->size == 0) {
+        acc[0] = 1;
+        big32_trim(result);
+        return 0;
+    }
+
+    int ebits = limbs_bits(e->digits, e->size);
+    int w = window_bits(ebits);
+    modmul_t ctx = {m->digits, n, m->digits[0] & 1, 0, NULL, NULL, NULL, NULL};
+    ctx.product = arena_alloc(2 * n + 1);
+    ctx.quotient = arena_alloc(n + 2);
+    ctx.mul_tmp = arena_alloc(mul_tmp_limbs(n));
+    ctx.div_tmp = arena_alloc(3 * n + 1);
+    uint32_t *one = arena_alloc(n);
+    uint32_t *table = arena_alloc(n << (w - 1));
+    if (!ctx.product || !ctx.quotient || !ctx.mul_tmp || !ctx.div_tmp || !one || !table) return -1;
+
+    for (int i = 0; i < n; i++) one[i] = 0;
+    one[0] = 1;
+    for (int i = 0; i < n; i++) table[i] = i < base.size ? base.digits[i] : 0;
+
+    if (ctx.montgomery) {
+        uint32_t inv = m->digits[0];
+        for (int i = 0; i < 4; i++) inv *= 2 - m->digits[0] * inv;
+        ctx.minv = 0 - inv;
+
+        /* R^2 mod m, with R = 2^(32n), moves values into Montgomery form. */
+        uint32_t *r2 = arena_alloc(2 * n + 1);
+        uint32_t *qt = arena_alloc(n + 2);
+        uint32_t *r2m = arena_alloc(n);
+        uint32_t *dt = arena_alloc(3 * n + 2);
+        if (!r2 || !qt || !r2m || !dt) return -1;
+        for (int i = 0; i < 2 * n; i++) r2[i] = 0;
+        r2[2 * n] = 1;
+        if (n == 1) r2m[0] = limbs_divmod_1(qt, r2, 3, m->digits[0]);
+        else limbs_divmod(qt, r2m, r2, 2 * n + 1, m->digits, n, dt);
+        mod_mul(&ctx, table, table, r2m);
+    }
+
+    if (w > 1) {
+        uint32_t *square = acc;
+        mod_mul(&ctx, square, table, table);
+        for (int i = 1; i < 1 << (w - 1); i++) {
+            mod_mul(&ctx, table + i * n, table + (i - 1) * n, square);
+        }
+    }
+
+    int started = 0;
+    for (int i = ebits - 1; i >= 0;) {
+        if (!limbs_bit(e->digits, i)) {
+            mod_mul(&ctx, acc, acc, acc);
+            i--;
+            continue;
+        }
+        int j = i - w + 1 > 0 ? i - w + 1 : 0;
+        while (!limbs_bit(e->digits, j)) j++;
+        uint32_t value = 0;
+        for (int k = i; k >= j; k--) value = (value << 1) | (uint32_t)limbs_bit(e->digits, k);
+
+        const uint32_t *power = table + (value >> 1) * n;
+        if (started) {
+            for (int k = i; k >= j; k--) mod_mul(&ctx, acc, acc, acc);
+            mod_mul(&ctx, acc, acc, power);
         } else {
-            borrow = 0;
+            for (int k = 0; k < n; k++) acc[k] = power[k];
+            started = 1;
         }
-        result->digits[i] = (uint32_t)diff;
+        i = j - 1;
     }
-    result->size = a->size;
-    while (result->size > 0 && result->digits[result->size - 1] == 0) result->size--;
-    if (result->size == 0) result->sign = 1;
+
+    if (ctx.montgomery) mod_mul(&ctx, acc, acc, one);
+    big32_trim(result);
+    return 0;
 }
 
-static void big32_add(const big32_t* a, const big32_t* b, big32_t* result) {
-    if (a->sign == b->sign) {
-        big32_zero(result);
-        result->sign = a->sign;
-        uint64_t carry = 0;
-        int max = (a->size > b->size) ? a->size : b->size;
-        for (int i = 0; i < max || carry; i++) {
-            uint64_t x = (i < a->size) ? a->digits[i] : 0;
-            uint64_t y = (i < b->size) ? b->digits[i] : 0;
-            uint64_t sum = x + y + carry;
-            result->digits[i] = (uint32_t)(sum & 0xFFFFFFFF);
-            carry = sum >> 32;
+/*
+ * Decimal conversion works in base-10^9 chunks. Above the thresholds the
+ * number is split at 10^(9*2^k), so each half is converted on its own and
+ * the big multiply/divide at the split does the heavy lifting.
+ */
+static uint32_t pow10_store[1 << POW10_CACHED];
+static uint32_t *pow10_limbs[POW10_LEVELS];
+static int pow10_size[POW10_LEVELS];
+static int pow10_count;
+
+/* Levels from POW10_CACHED up are built in the arena and go with it. */
+static void pow10_release(void) {
+    if (pow10_count > POW10_CACHED) pow10_count = POW10_CACHED;
+}
+
+/* Adds 10^(9*2^k) for the next level k by squaring the one below. */
+static int pow10_extend(void) {
+    int k = pow10_count;
+    if (k == POW10_LEVELS) return -1;
+    if (k == 0) {
+        pow10_store[0] = CHUNK_BASE;
+        pow10_limbs[0] = pow10_store;
+        pow10_size[0] = 1;
+        pow10_count = 1;
+        return 0;
+    }
+
+    int n = pow10_size[k - 1];
+    uint32_t *p = k < POW10_CACHED ? pow10_store + (1 << k) - 1 : arena_alloc(2 * n);
+    int mark = arena_top;
+    uint32_t *tmp = arena_alloc(mul_tmp_limbs(n));
+    if (!p || !tmp) return -1;
+    limbs_sqr_n(p, pow10_limbs[k - 1], n, tmp);
+    arena_top = mark;
+    n *= 2;
+    while (p[n - 1] == 0) n--;
+    pow10_limbs[k] = p;
+    pow10_size[k] = n;
+    pow10_count++;
+    return 0;
+}
+
+/* The levels are built up front so the conversions can free scratch by
+ * rewinding the arena. */
+static int pow10_prepare_digits(int len) {
+    if (pow10_count == 0 && pow10_extend() != 0) return -1;
+    while ((CHUNK_DIGITS << pow10_count) < len) {
+        if (pow10_extend() != 0) return -1;
+    }
+    return 0;
+}
+
+static int pow10_prepare_limbs(int n) {
+    if (pow10_count == 0 && pow10_extend() != 0) return -1;
+    while ((2 * pow10_size[pow10_count - 1] - 1) * 2 <= n) {
+        if (pow10_extend() != 0) return -1;
+    }
+    return 0;
+}
+
+static uint32_t parse_chunk(const char *str, int len) {
+    uint32_t v = 0;
+    for (int i = 0; i < len; i++) v = v * 10 + (uint32_t)(str[i] - '0');
+    return v;
+}
+
+/* Parses len decimal digits into r (len / 9 + 2 limbs); returns the
+ * limb count or -1 when the arena runs out. */
+static int limbs_from_decimal(uint32_t *r, const char *str, int len) {
+    if (len <= PARSE_DC_THRESHOLD) {
+        int first = len % CHUNK_DIGITS ? len % CHUNK_DIGITS : CHUNK_DIGITS;
+        int n = 0;
+        uint32_t v = parse_chunk(str, first);
+        if (v) r[n++] = v;
+        for (int pos = first; pos < len; pos += CHUNK_DIGITS) {
+            uint32_t carry = parse_chunk(str + pos, CHUNK_DIGITS);
+            for (int i = 0; i < n; i++) {
+                uint64_t t = (uint64_t)r[i] * CHUNK_BASE + carry;
+                r[i] = (uint32_t)t;
+                carry = (uint32_t)(t >> 32);
+            }
+            if (carry) r[n++] = carry;
         }
-        result->size = max;
-        if (carry && result->size < MAX_DIGITS)
-            result->digits[result->size++] = (uint32_t)carry;
-    } else {
-        big32_t t = *b;
-        t.sign *= -1;
-        big32_sub(a, &t, result);
-    }
-}
-
-static void big32_mul(const big32_t* a, const big32_t* b, big32_t* result) {
-    big32_zero(result);
-    result->sign = a->sign * b->sign;
-    for (int i = 0; i < a->size; i++) {
-        uint64_t carry = 0;
-        for (int j = 0; j < b->size || carry; j++) {
-            uint64_t x = result->digits[i + j];
-            uint64_t y = (j < b->size) ? (uint64_t)a->digits[i] * b->digits[j] : 0;
-            uint64_t sum = x + y + carry;
-            result->digits[i + j] = (uint32_t)(sum & 0xFFFFFFFF);
-            carry = sum >> 32;
+        return n;
+    }
+
+    int k = 0;
+    while (k + 1 < pow10_count && (CHUNK_DIGITS << (k + 1)) < len) k++;
+    int low_digits = CHUNK_DIGITS << k;
+    const uint32_t *pow = pow10_limbs[k];
+    int pn = pow10_size[k];
+
+    int mark = arena_top;
+    uint32_t *hi = arena_alloc(len / CHUNK_DIGITS + 2);
+    if (!hi) return -1;
+    int hn = limbs_from_decimal(hi, str, len - low_digits);
+    int ln = limbs_from_decimal(r, str + len - low_digits, low_digits);
+    if (hn < 0 || ln < 0) return -1;
+    int n = ln;
+    if (hn) {
+        uint32_t *prod = arena_alloc(hn + pn);
+        uint32_t *tmp = arena_alloc(mul_tmp_limbs(hn < pn ? hn : pn));
+        if (!prod || !tmp) return -1;
+        if (hn >= pn) limbs_mul(prod, hi, hn, pow, pn, tmp);
+        else limbs_mul(prod, pow, pn, hi, hn, tmp);
+        n = hn + pn;
+        for (int i = ln; i < n; i++) r[i] = 0;
+        limbs_add(r, prod, n, r, ln);
+    }
+    arena_top = mark;
+    while (n > 0 && r[n - 1] == 0) n--;
+    return n;
+}
+
+/* Writes exactly width digits of a, zero-padded on the left. */
+static int limbs_to_decimal(const uint32_t *a, int n, char *out, int width) {
+    while (n > 0 && a[n - 1] == 0) n--;
+    int mark = arena_top;
+    if (n < PRINT_DC_THRESHOLD) {
+        uint32_t *t = arena_alloc(n);
+        if (!t) return -1;
+        for (int i = 0; i < n; i++) t[i] = a[i];
+        int pos = width;
+        while (n > 0 && pos > 0) {
+            uint32_t chunk = limbs_divmod_1(t, t, n, CHUNK_BASE);
+            while (n > 0 && t[n - 1] == 0) n--;
+            for (int i = 0; i < CHUNK_DIGITS && pos > 0; i++) {
+                out[--pos] = (char)('0' + chunk % 10);
+                chunk /= 10;
+            }
         }
+        while (pos > 0) out[--pos] = '0';
+        arena_top = mark;
+        return 0;
     }
-    result->size = a->size + b->size;
-    while (result->size > 0 && result->digits[result->size - 1] == 0) result->size--;
-    if (result->size == 0) result->sign = 1;
-}
-
-static void big32_divmod(const big32_t* a, const big32_t* b, big32_t* quotient, big32_t* remainder) {
-    big32_zero(quotient);
-    big32_zero(remainder);
-    big32_t tmp = *a;
-    tmp.sign = 1;
-    big32_t bv = *b;
-    bv.sign = 1;
-    for (int i = tmp.size * 32 - 1; i >= 0; i--) {
-        for (int j = remainder->size; j > 0; j--) {
-            remainder->digits[j] = remainder->digits[j - 1];
+
+    int k = 0;
+    while (k + 1 < pow10_count && pow10_size[k + 1] * 2 <= n) k++;
+    const uint32_t *pow = pow10_limbs[k];
+    int pn = pow10_size[k];
+    int low_digits = CHUNK_DIGITS << k;
+
+    uint32_t *q = arena_alloc(n - pn + 1);
+    uint32_t *r = arena_alloc(pn);
+    uint32_t *tmp = arena_alloc(n + pn + 1);
+    if (!q || !r || !tmp) return -1;
+    limbs_divmod(q, r, a, n, pow, pn, tmp);
+    if (limbs_to_decimal(r, pn, out + width - low_digits, low_digits) != 0) return -1;
+    if (limbs_to_decimal(q, n - pn + 1, out, width - low_digits) != 0) return -1;
+    arena_top = mark;
+    return 0;
+}
+
+static int big32_parse(big32_t* num, const char* str, int len) {
+    big32_zero(num);
+    int sign = 1;
+    if (len > 0 && str[0] == '-') {
+        sign = -1;
+        str++;
+        len--;
+    }
+    while (len > 0 && str[0] == '0') {
+        str++;
+        len--;
+    }
+    if (len == 0) return 0;
+
+    if (pow10_prepare_digits(len) != 0) return -1;
+    uint32_t *d = arena_alloc(len / CHUNK_DIGITS + 2);
+    if (!d) return -1;
+    int n = limbs_from_decimal(d, str, len);
+    if (n < 0) return -1;
+    num->digits = d;
+    num->size = n;
+    num->sign = sign;
+    big32_trim(num);
+    return 0;
+}
+
+static int big32_print(const big32_t* num) {
+    if (num->size == 0) {
+        print("0\n");
+        return 0;
+    }
+    if (pow10_prepare_limbs(num->size) != 0) return -1;
+    int width = num->size * 10;
+    char *buf = (char *)arena_alloc(width / 4 + 1);
+    if (!buf || limbs_to_decimal(num->digits, num->size, buf, width) != 0) return -1;
+
+    int start = 0;
+    while (start < width - 1 && buf[start] == '0') start++;
+    buf[width] = 0;
+    if (num->sign == -1) putchar('-');
+    print(buf + start);
+    print("\n");
+    return 0;
+}
+
+static big32_t bench_a, bench_b, bench_c, bench_r, bench_m;
+
+static int big32_fill(big32_t* num, int limbs, uint32_t seed) {
+    num->digits = arena_alloc(limbs);
+    if (!num->digits) return -1;
+    for (int i = 0; i < limbs; i++) {
+        seed = seed * 1103515245u + 12345u;
+        num->digits[i] = seed ^ (seed >> 16);
+    }
+    num->digits[limbs - 1] |= 1;
+    num->size = limbs;
+    num->sign = 1;
+    return 0;
+}
+
+void calc_bench_mul(int limbs, uint32_t iterations) {
+    arena_reset();
+    if (big32_fill(&bench_a, limbs, 1) == 0 && big32_fill(&bench_b, limbs, 2) == 0) {
+        int mark = arena_top;
+        for (uint32_t i = 0; i < iterations; i++) {
+            big32_mul(&bench_a, &bench_b, &bench_r);
+            arena_top = mark;
+        }
+    }
+    arena_reset();
+}
+
+void calc_bench_divmod(int limbs, uint32_t iterations) {
+    arena_reset();
+    if (big32_fill(&bench_a, limbs, 3) == 0 && big32_fill(&bench_b, limbs / 2 > 0 ? limbs / 2 : 1, 4) == 0) {
+        int mark = arena_top;
+        for (uint32_t i = 0; i < iterations; i++) {
+            big32_divmod(&bench_a, &bench_b, &bench_r, &bench_m);
+            arena_top = mark;
+        }
+    }
+    arena_reset();
+}
+
+void calc_bench_powmod(int limbs, uint32_t iterations) {
+    arena_reset();
+    if (big32_fill(&bench_a, limbs, 5) == 0 && big32_fill(&bench_b, limbs, 6) == 0 &&
+        big32_fill(&bench_c, limbs, 7) == 0) {
+        bench_c.digits[0] |= 1;
+        int mark = arena_top;
+        for (uint32_t i = 0; i < iterations; i++) {
+            big32_powmod(&bench_a, &bench_b, &bench_c, &bench_r);
+            arena_top = mark;
+        }
+    }
+    arena_reset();
+}
+
+static int calc_error(const char* msg) {
+    vga_error_begin();
+    print(msg);
+    vga_error_end();
+    return -1;
+}
+
+/*
+ * Expressions are compiled to postfix bytecode for a small stack VM.
+ * Constants are parsed once into the program, so a cached program runs
+ * without touching the source text again. An assignment only records the
+ * target name; the variable is created or updated once the run succeeds.
+ */
+enum {
+    OP_END,
+    OP_CONST,   /* operand: constant index */
+    OP_LOAD,    /* operand: variable index */
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_POW,
+    OP_POWMOD
+};
+
+typedef struct {
+    int length;
+    char text[CALC_EXPR_MAX];
+    uint8_t code[CALC_CODE_MAX];
+    char target[CALC_NAME_MAX + 1];
+    big32_t consts[CALC_CONST_MAX];
+    uint32_t *limbs;
+} calc_program_t;
+
+typedef struct {
+    const char *src;
+    int pos;
+    int length;
+    calc_program_t *prog;
+    int code_len;
+    int last_op;
+    int prev_op;
+    int const_count;
+    int limb_count;
+    int limb_cap;
+    int stack;
+    int nesting;
+    const char *error;
+} calc_compiler_t;
+
+static calc_program_t calc_cache[CALC_CACHE_ENTRIES];
+static uint32_t calc_cache_limbs[CALC_CACHE_ENTRIES][CALC_CONST_LIMBS];
+static int calc_cache_next;
+static calc_program_t calc_uncached;
+
+/* Variables keep their limbs in var_pool across commands; slot 0 is ans. */
+static char var_names[CALC_VARS][CALC_NAME_MAX + 1] = {"ans"};
+static big32_t var_values[CALC_VARS] = {{NULL, 0, 1}};
+static int var_count = 1;
+static uint32_t var_pool[CALC_VAR_LIMBS];
+
+static int is_name_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static char peek(calc_compiler_t *c) {
+    while (c->pos < c->length && c->src[c->pos] == ' ') c->pos++;
+    return c->pos < c->length ? c->src[c->pos] : 0;
+}
+
+static int fail(calc_compiler_t *c, const char *error) {
+    if (!c->error) c->error = error;
+    return -1;
+}
+
+/* effect is the change in stack depth once the op has run. */
+static int emit(calc_compiler_t *c, uint8_t op, int operand, int effect) {
+    int size = operand >= 0 ? 2 : 1;
+    if (c->code_len + size >= CALC_CODE_MAX) return fail(c, "Error: Expression too long\n");
+    c->prev_op = c->last_op;
+    c->last_op = c->code_len;
+    c->prog->code[c->code_len++] = op;
+    if (operand >= 0) c->prog->code[c->code_len++] = (uint8_t)operand;
+    c->stack += effect;
+    if (c->stack > CALC_STACK_MAX) return fail(c, "Error: Expression too complex\n");
+    return 0;
+}
+
+static int find_var(const char *name, int len) {
+    for (int i = 0; i < var_count; i++) {
+        if (kstrncmp(var_names[i], name, (size_t)len) == 0 && var_names[i][len] == 0) return i;
+    }
+    return -1;
+}
+
+static int read_name(calc_compiler_t *c, int *start) {
+    *start = c->pos;
+    while (c->pos < c->length && (is_name_start(c->src[c->pos]) || is_digit(c->src[c->pos]))) c->pos++;
+    int len = c->pos - *start;
+    if (len > CALC_NAME_MAX) return fail(c, "Error: Variable name too long\n");
+    return len;
+}
+
+static int compile_number(calc_compiler_t *c) {
+    int start = c->pos;
+    while (c->pos < c->length && is_digit(c->src[c->pos])) c->pos++;
+
+    big32_t num;
+    if (big32_parse(&num, c->src + start, c->pos - start) != 0) return fail(c, "Error: Number too large\n");
+    if (c->const_count == CALC_CONST_MAX || c->limb_count + num.size > c->limb_cap) {
+        return fail(c, "Error: Expression too long\n");
+    }
+    big32_t *k = &c->prog->consts[c->const_count];
+    k->digits = c->prog->limbs + c->limb_count;
+    k->size = num.size;
+    k->sign = num.sign;
+    for (int i = 0; i < num.size; i++) k->digits[i] = num.digits[i];
+    c->limb_count += num.size;
+    return emit(c, OP_CONST, c->const_count++, 1);
+}
+
+static int compile_expr(calc_compiler_t *c);
+
+static int compile_primary(calc_compiler_t *c) {
+    char ch = peek(c);
+    if (is_digit(ch)) return compile_number(c);
+    if (is_name_start(ch)) {
+        int start;
+        int len = read_name(c, &start);
+        if (len < 0) return -1;
+        if (peek(c) == '(') {
+            if (len != 6 || kstrncmp(c->src + start, "powmod", 6) != 0) return fail(c, "Error: Unknown function\n");
+            c->pos++;
+            for (int i = 0; i < 3; i++) {
+                if (compile_expr(c) != 0) return -1;
+                if (peek(c) != (i < 2 ? ',' : ')')) return fail(c, "Invalid expression\n");
+                c->pos++;
+            }
+            return emit(c, OP_POWMOD, -1, -2);
+        }
+        int var = find_var(c->src + start, len);
+        if (var < 0) return fail(c, "Error: Unknown variable\n");
+        return emit(c, OP_LOAD, var, 1);
+    }
+    if (ch == '(') {
+        c->pos++;
+        if (compile_expr(c) != 0) return -1;
+        if (peek(c) != ')') return fail(c, "Error: Missing )\n");
+        c->pos++;
+        return 0;
+    }
+    return fail(c, "Invalid expression\n");
+}
+
+static int compile_unary(calc_compiler_t *c);
+
+/* power := primary ['^' unary], so ^ is right-associative and -2^2 is -4. */
+static int compile_power(calc_compiler_t *c) {
+    if (compile_primary(c) != 0) return -1;
+    if (peek(c) != '^') return 0;
+    if (++c->nesting > CALC_NESTING_MAX) return fail(c, "Error: Expression too complex\n");
+    c->pos++;
+    if (compile_unary(c) != 0) return -1;
+    c->nesting--;
+    return emit(c, OP_POW, -1, -1);
+}
+
+static int compile_unary(calc_compiler_t *c) {
+    char ch = peek(c);
+    if (ch == '-' || ch == '+') {
+        if (++c->nesting > CALC_NESTING_MAX) return fail(c, "Error: Expression too complex\n");
+        c->pos++;
+        if (compile_unary(c) != 0) return -1;
+        c->nesting--;
+        return ch == '-' ? emit(c, OP_NEG, -1, 0) : 0;
+    }
+    return compile_power(c);
+}
+
+static int compile_term(calc_compiler_t *c) {
+    if (compile_unary(c) != 0) return -1;
+    for (;;) {
+        char ch = peek(c);
+        uint8_t op = ch == '*' ? OP_MUL : ch == '/' ? OP_DIV : ch == '%' ? OP_MOD : OP_END;
+        if (op == OP_END) return 0;
+        c->pos++;
+
+        /* a ^ b % m (or -a ^ b % m) becomes one powmod, so a^b is never
+         * built in full. */
+        const uint8_t *code = c->prog->code;
+        int tail = c->last_op == c->code_len - 1;
+        int negate = tail && code[c->last_op] == OP_NEG && c->prev_op == c->last_op - 1 && code[c->prev_op] == OP_POW;
+        if (op == OP_MOD && (negate || (tail && code[c->last_op] == OP_POW))) {
+            c->code_len -= negate ? 2 : 1;
+            if (++c->stack > CALC_STACK_MAX) return fail(c, "Error: Expression too complex\n");
+            if (compile_unary(c) != 0 || emit(c, OP_POWMOD, -1, -2) != 0) return -1;
+            if (negate && emit(c, OP_NEG, -1, 0) != 0) return -1;
+            continue;
+        }
+        if (compile_unary(c) != 0 || emit(c, op, -1, -1) != 0) return -1;
+    }
+}
+
+static int compile_expr(calc_compiler_t *c) {
+    if (++c->nesting > CALC_NESTING_MAX) return fail(c, "Error: Expression too complex\n");
+    if (compile_term(c) != 0) return -1;
+    for (;;) {
+        char ch = peek(c);
+        if (ch != '+' && ch != '-') break;
+        c->pos++;
+        if (compile_term(c) != 0 || emit(c, ch == '+' ? OP_ADD : OP_SUB, -1, -1) != 0) return -1;
+    }
+    c->nesting--;
+    return 0;
+}
+
+/* statement := [name '='] expr */
+static int compile_statement(calc_compiler_t *c) {
+    c->prog->target[0] = 0;
+    if (is_name_start(peek(c))) {
+        int save = c->pos;
+        int start;
+        int len = read_name(c, &start);
+        if (len < 0) return -1;
+        if (peek(c) == '=') {
+            c->pos++;
+            if (find_var(c->src + start, len) < 0 && var_count == CALC_VARS) {
+                return fail(c, "Error: Too many variables\n");
+            }
+            kstrncpy(c->prog->target, c->src + start, (size_t)len);
+            c->prog->target[len] = 0;
+        } else {
+            c->pos = save;
         }
-        remainder->digits[0] = (tmp.digits[i / 32] >> (i % 32)) & 1;
-        remainder->size++;
-        while (remainder->size > 0 && remainder->digits[remainder->size - 1] == 0) remainder->size--;
-        if (big32_compare(remainder, &bv) >= 0) {
-            big32_sub(remainder, &bv, remainder);
-            quotient->digits[i / 32] |= (1U << (i % 32));
+    }
+    if (compile_expr(c) != 0) return -1;
+    if (peek(c) != 0) return fail(c, "Invalid expression\n");
+    return emit(c, OP_END, -1, 0);
+}
+
+static calc_program_t *calc_compile(const char *expr, int length, const char **error) {
+    for (int i = 0; i < CALC_CACHE_ENTRIES; i++) {
+        calc_program_t *prog = &calc_cache[i];
+        if (prog->length == length && kstrncmp(prog->text, expr, (size_t)length) == 0) return prog;
+    }
+
+    /* Text too long for the cache is compiled with its constants in the
+     * arena and thrown away after the run. */
+    int cached = length <= CALC_EXPR_MAX;
+    calc_program_t *prog = cached ? &calc_cache[calc_cache_next] : &calc_uncached;
+    int limb_cap = cached ? CALC_CONST_LIMBS : length / CHUNK_DIGITS + CALC_CONST_MAX;
+    prog->limbs = cached ? calc_cache_limbs[calc_cache_next] : arena_alloc(limb_cap);
+    prog->length = 0;
+    if (!prog->limbs) {
+        *error = "Error: Number too large\n";
+        return NULL;
+    }
+    calc_compiler_t c = {expr, 0, length, prog, 0, 0, 0, 0, 0, limb_cap, 0, 0, NULL};
+    if (compile_statement(&c) != 0) {
+        *error = c.error;
+        return NULL;
+    }
+    if (!cached) return prog;
+    for (int i = 0; i < length; i++) prog->text[i] = expr[i];
+    prog->length = length;
+    calc_cache_next = (calc_cache_next + 1) % CALC_CACHE_ENTRIES;
+    return prog;
+}
+
+static const char *calc_execute(const calc_program_t *prog, big32_t *result) {
+    big32_t stack[CALC_STACK_MAX];
+    int sp = 0;
+    const uint8_t *pc = prog->code;
+    for (;;) {
+        uint8_t op = *pc++;
+        big32_t r;
+        big32_t mod;
+        int status = 0;
+        switch (op) {
+        case OP_END:
+            *result = stack[sp - 1];
+            return NULL;
+        case OP_CONST:
+            stack[sp++] = prog->consts[*pc++];
+            continue;
+        case OP_LOAD:
+            stack[sp++] = var_values[*pc++];
+            continue;
+        case OP_NEG:
+            if (stack[sp - 1].size) stack[sp - 1].sign = -stack[sp - 1].sign;
+            continue;
+        case OP_ADD:
+            status = big32_add(&stack[sp - 2], &stack[sp - 1], &r);
+            break;
+        case OP_SUB:
+            status = big32_sub(&stack[sp - 2], &stack[sp - 1], &r);
+            break;
+        case OP_MUL:
+            status = big32_mul(&stack[sp - 2], &stack[sp - 1], &r);
+            break;
+        case OP_DIV:
+        case OP_MOD:
+            if (stack[sp - 1].size == 0) return "Error: Division by zero\n";
+            status = big32_divmod(&stack[sp - 2], &stack[sp - 1], &r, &mod);
+            if (op == OP_MOD) r = mod;
+            break;
+        case OP_POW:
+            if (stack[sp - 1].sign < 0) return "Error: Negative exponent\n";
+            status = big32_pow(&stack[sp - 2], &stack[sp - 1], &r);
+            break;
+        case OP_POWMOD:
+            if (stack[sp - 1].size == 0) return "Error: Division by zero\n";
+            if (stack[sp - 2].sign < 0) return "Error: Negative exponent\n";
+            status = big32_powmod(&stack[sp - 3], &stack[sp - 2], &stack[sp - 1], &r);
+            sp--;
+            break;
         }
+        if (status != 0) return "Error: Result too large\n";
+        stack[--sp - 1] = r;
     }
-    quotient->size = tmp.size;
-    quotient->sign = a->sign * b->sign;
-    while (quotient->size > 0 && quotient->digits[quotient->size - 1] == 0) quotient->size--;
-    remainder->sign = a->sign;
-    if (remainder->size == 0) remainder->sign = 1;
 }
 
-void calc_command(const char* expr) {
-    big32_t a, b, r, mod;
-    char op = 0;
+/* Stores result in ans and in the program's target, which is only created
+ * here, and repacks every variable into var_pool. The result lives in the
+ * arena and the old values in the pool itself, so they are gathered in the
+ * arena first. Nothing changes if the values do not fit. */
+static int vars_commit(const calc_program_t *prog, const big32_t *result) {
+    int len = (int)kstrlen(prog->target);
+    int target = len ? find_var(prog->target, len) : 0;
+    int count = var_count;
+    if (target < 0) {
+        if (count == CALC_VARS) return -1;
+        target = count++;
+    }
+
+    big32_t vars[CALC_VARS];
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        vars[i] = i == 0 || i == target ? *result : var_values[i];
+        total += vars[i].size;
+    }
+    uint32_t *tmp = arena_alloc(total);
+    if (total > CALC_VAR_LIMBS || (total && !tmp)) return -1;
+
     int pos = 0;
-    int length = (int)kstrlen(expr);
-    while (pos < length && expr[pos] == ' ') pos++;
-    int start = pos;
-    while (pos < length && expr[pos] >= '0' && expr[pos] <= '9') pos++;
-    if (pos == start) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Invalid expression\n");
-        set_text_color(COLOR_WHITE, COLOR_BLACK); 
-        return;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < vars[i].size; j++) tmp[pos + j] = vars[i].digits[j];
+        pos += vars[i].size;
     }
-    char buf_a[128];
-    int len_a = pos - start;
-    for (int i = 0; i < len_a; i++) buf_a[i] = expr[start + i];
-    buf_a[len_a] = 0;
-    big32_parse(&a, buf_a);
-    while (pos < length && expr[pos] == ' ') pos++;
-    if (pos >= length) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Invalid operator\n");
-        set_text_color(COLOR_WHITE, COLOR_BLACK); 
-        return;
+    pos = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < vars[i].size; j++) var_pool[pos + j] = tmp[pos + j];
+        var_values[i].digits = var_pool + pos;
+        var_values[i].size = vars[i].size;
+        var_values[i].sign = vars[i].sign;
+        pos += vars[i].size;
     }
-    op = expr[pos++];
-    while (pos < length && expr[pos] == ' ') pos++;
-    start = pos;
-    while (pos < length && expr[pos] >= '0' && expr[pos] <= '9') pos++;
-    if (pos == start) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Invalid expression\n");
-        set_text_color(COLOR_WHITE, COLOR_BLACK); 
-        return;
+    if (count > var_count) {
+        kstrncpy(var_names[target], prog->target, (size_t)len);
+        var_names[target][len] = 0;
+        var_count = count;
     }
-    char buf_b[128];
-    int len_b = pos - start;
-    for (int i = 0; i < len_b; i++) buf_b[i] = expr[start + i];
-    buf_b[len_b] = 0;
-    big32_parse(&b, buf_b);
-    if (op == '+') {
-        big32_add(&a, &b, &r);
-        big32_print(&r);
-    } else if (op == '-') {
-        big32_sub(&a, &b, &r);
-        big32_print(&r);
-    } else if (op == '*') {
-        big32_mul(&a, &b, &r);
-        big32_print(&r);
-    } else if (op == '/') {
-        if (b.size == 0 || (b.size == 1 && b.digits[0] == 0)) { 
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Error: Division by zero\n");
-            set_text_color(COLOR_WHITE, COLOR_BLACK); 
-            return;
+    return 0;
+}
+
+static int calc_run(const char* expr) {
+    int length = (int)kstrlen(expr);
+    while (length > 0 && *expr == ' ') {
+        expr++;
+        length--;
+    }
+    while (length > 0 && expr[length - 1] == ' ') length--;
+    if (length == 0) return calc_error("Invalid expression\n");
+
+    const char *error = NULL;
+    calc_program_t *prog = calc_compile(expr, length, &error);
+    if (!prog) return calc_error(error);
+
+    big32_t result;
+    error = calc_execute(prog, &result);
+    if (error) return calc_error(error);
+    int printed = big32_print(&result);
+    int kept = vars_commit(prog, &result);
+    if (printed != 0) calc_error("Error: Result too large\n");
+    if (kept != 0) {
+        vga_error_begin();
+        print("Error: Result too large to keep, ");
+        if (prog->target[0]) {
+            print(prog->target);
+            print(" and ");
         }
-        big32_divmod(&a, &b, &r, &mod);
-        big32_print(&r);
-    } else if (op == '%') {
-        if (b.size == 0 || (b.size == 1 && b.digits[0] == 0)) { 
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Error: Division by zero\n");
-            set_text_color(COLOR_WHITE, COLOR_BLACK); 
-            return;
+        print("ans not updated\n");
+        vga_error_end();
+    }
+    return printed != 0 || kept != 0 ? -1 : 0;
+}
+
+int calc_command(const char* expr) {
+    int status = calc_run(expr);
+    arena_reset();
+    return status;
+}
+
+/* powmod a b m: each operand is a number, variable or expression
+ * without spaces. */
+int calc_powmod_command(const char* args) {
+    static const char usage[] = "Usage: powmod <base> <exponent> <modulus>\n";
+    char expr[CALC_EXPR_MAX + 1];
+    int len = 0;
+    int count = 0;
+    const char *prefix = "powmod(";
+    while (*prefix) expr[len++] = *prefix++;
+    for (;;) {
+        while (*args == ' ') args++;
+        if (*args == 0) break;
+        if (count == 3) return calc_error(usage);
+        if (count++) expr[len++] = ',';
+        while (*args && *args != ' ') {
+            if (len >= CALC_EXPR_MAX - 1) return calc_error("Error: Expression too long\n");
+            expr[len++] = *args++;
         }
-        big32_divmod(&a, &b, &r, &mod);
-        big32_print(&mod);
-    } else {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Unknown operator\n");
-        set_text_color(COLOR_WHITE, COLOR_BLACK); 
     }
+    if (count != 3) return calc_error(usage);
+    expr[len++] = ')';
+    expr[len] = 0;
+    return calc_command(expr);
 }
@@ -19,6 +19,12 @@
 #ifndef CALC_H
 #define CALC_H
 
-void calc_command(const char *args);
+#include <stdint.h>
+
+int calc_command(const char *args);
+int calc_powmod_command(const char *args);
+void calc_bench_mul(int limbs, uint32_t iterations);
+void calc_bench_divmod(int limbs, uint32_t iterations);
+void calc_bench_powmod(int limbs, uint32_t iterations);
 
 #endif
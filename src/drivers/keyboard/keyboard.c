@@ -19,6 +19,11 @@
 #include <stdint.h>
 #include "vga.h"
 #include "keyboard.h"
+#include "serial.h"
+#include "timer.h"
+#include "latency.h"
+
+#define SERIAL_ESCAPE_SPINS 5000
 
 static const char scancode_ascii[128] = {
     0, 27, '1','2','3','4','5','6','7','8','9','0','-','=','\b',
@@ -52,29 +57,108 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
-int keyboard_getchar() {
+static int serial_wait_byte(void) {
+    for (int i = 0; i < SERIAL_ESCAPE_SPINS; i++) {
+        int c = serial_getchar();
+        if (c >= 0) return c;
+        inb(0x64);
+    }
+    return -1;
+}
+
+static int serial_read_key(void) {
+    int c = serial_getchar();
+    if (c < 0) return -1;
+    if (c == '\r') return KEY_ENTER;
+    if (c == 0x7F) return KEY_BACKSPACE;
+    /* Terminals send Backspace, Tab and Enter as ^H, ^I and ^J, so only
+     * the other control bytes can be told apart as Ctrl+letter. */
+    if (c >= 0x01 && c <= 0x1A && c != '\b' && c != '\t' && c != '\n') return KEY_CTRL_LETTER + (c - 1);
+    if (c != 27) return c;
+
+    c = serial_wait_byte();
+    if (c != '[' && c != 'O') return KEY_ESCAPE;
+
+    int param = 0;
+    int modifier = 0;
+    c = serial_wait_byte();
+    while (c >= '0' && c <= '9') {
+        param = param * 10 + (c - '0');
+        c = serial_wait_byte();
+    }
+    if (c == ';') {
+        c = serial_wait_byte();
+        while (c >= '0' && c <= '9') {
+            modifier = modifier * 10 + (c - '0');
+            c = serial_wait_byte();
+        }
+    }
+    int ctrl = modifier == 5;
+
+    switch (c) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return ctrl ? KEY_CTRL_RIGHT : KEY_RIGHT;
+        case 'D': return ctrl ? KEY_CTRL_LEFT : KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        case 'P':
+        case 'Q':
+        case 'R':
+        case 'S':
+            return modifier == 3 ? KEY_CONSOLE_1 + (c - 'P') : -1;
+        case '~':
+            if (param == 1 || param == 7) return KEY_HOME;
+            if (param == 4 || param == 8) return KEY_END;
+            if (param == 3) return ctrl ? KEY_CTRL_DELETE : KEY_DELETE;
+            if (param == 5) vga_scroll_view(get_screen_height() - 1);
+            if (param == 6) vga_scroll_view(-(get_screen_height() - 1));
+            return -1;
+        default:
+            return -1;
+    }
+}
+
+static uint64_t key_tsc = 0;
+
+static int keyboard_read_key() {
     uint8_t sc;
     static int shift = 0;
+    static int ctrl = 0;
+    static int alt = 0;
     static int caps_lock = 0;
     static int num_lock = 1;
 
     while (1) {
 
-        while (!(inb(0x64) & 1));
+        while (!(inb(0x64) & 1)) {
+            int key = serial_read_key();
+            if (key >= 0) {
+                key_tsc = timer_read_tsc();
+                return key;
+            }
+        }
         sc = inb(0x60);
+        key_tsc = timer_read_tsc();
 
         if (sc == 0xE0) {
 
             while (!(inb(0x64) & 1));
             sc = inb(0x60);
 
-            if (sc == 0x4B) return KEY_LEFT;
-            if (sc == 0x4D) return KEY_RIGHT;
+            if (sc == 0x4B) return ctrl ? KEY_CTRL_LEFT : KEY_LEFT;
+            if (sc == 0x4D) return ctrl ? KEY_CTRL_RIGHT : KEY_RIGHT;
             if (sc == 0x48) return KEY_UP;
             if (sc == 0x50) return KEY_DOWN;
             if (sc == 0x47) return KEY_HOME;
             if (sc == 0x4F) return KEY_END;
-            if (sc == 0x53) return KEY_DELETE;
+            if (sc == 0x53) return ctrl ? KEY_CTRL_DELETE : KEY_DELETE;
+            if (sc == 0x49) vga_scroll_view(get_screen_height() - 1);
+            if (sc == 0x51) vga_scroll_view(-(get_screen_height() - 1));
+            if (sc == 0x1D) ctrl = 1;
+            if (sc == 0x9D) ctrl = 0;
+            if (sc == 0x38) alt = 1;
+            if (sc == 0xB8) alt = 0;
 
             continue;
         }
@@ -89,6 +173,30 @@ int keyboard_getchar() {
             continue;
         }
 
+        if (sc == 0x1D) {
+            ctrl = 1;
+            continue;
+        }
+
+        if (sc == 0x9D) {
+            ctrl = 0;
+            continue;
+        }
+
+        if (sc == 0x38) {
+            alt = 1;
+            continue;
+        }
+
+        if (sc == 0xB8) {
+            alt = 0;
+            continue;
+        }
+
+        if (alt && sc >= 0x3B && sc <= 0x3E) {
+            return KEY_CONSOLE_1 + (sc - 0x3B);
+        }
+
         if (sc == 0x3A) {
             caps_lock = !caps_lock;
             continue;
@@ -109,6 +217,14 @@ int keyboard_getchar() {
             if (sc < 128) {
                 char c = scancode_ascii[sc];
 
+                if (ctrl && c >= 'a' && c <= 'z') {
+                    return KEY_CTRL_LETTER + (c - 'a');
+                }
+
+                if (ctrl && c == '\b') {
+                    return KEY_CTRL_W;
+                }
+
                 if (c >= 'a' && c <= 'z') {
                     if (shift ^ caps_lock) {
                         c -= 32;
@@ -122,4 +238,12 @@ int keyboard_getchar() {
         }
 
     }
-}
\ No newline at end of file
+}
+
+int keyboard_getchar() {
+    vga_flush();
+    int key = keyboard_read_key();
+    if (key != KEY_NULL) latency_key_read(key_tsc);
+    vga_scroll_view_reset();
+    return key;
+}
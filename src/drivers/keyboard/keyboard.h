@@ -24,6 +24,7 @@
 #define KEY_NULL        ((int)0x00)
 #define KEY_BACKSPACE   ((int)'\b')
 #define KEY_ENTER       ((int)'\n')
+#define KEY_TAB         ((int)'\t')
 #define KEY_LEFT        ((int)0x80)
 #define KEY_RIGHT       ((int)0x81)
 #define KEY_UP          ((int)0x82)
@@ -31,6 +32,21 @@
 #define KEY_HOME        ((int)0x84)
 #define KEY_END         ((int)0x85)
 #define KEY_DELETE      ((int)0x86)
+#define KEY_CTRL_LEFT   ((int)0x87)
+#define KEY_CTRL_RIGHT  ((int)0x88)
+#define KEY_CTRL_DELETE ((int)0x89)
+#define KEY_CONSOLE_1   ((int)0x8A)
+#define KEY_CONSOLE_2   ((int)0x8B)
+#define KEY_CONSOLE_3   ((int)0x8C)
+#define KEY_CONSOLE_4   ((int)0x8D)
+#define KEY_ESCAPE      ((int)27)
+/* Ctrl+a..z get their own codes so Ctrl-H/I/J/M are not Backspace/Tab/Enter. */
+#define KEY_CTRL_LETTER ((int)0x90)
+#define KEY_CTRL_A      (KEY_CTRL_LETTER + 0)
+#define KEY_CTRL_E      (KEY_CTRL_LETTER + 4)
+#define KEY_CTRL_G      (KEY_CTRL_LETTER + 6)
+#define KEY_CTRL_R      (KEY_CTRL_LETTER + 17)
+#define KEY_CTRL_W      (KEY_CTRL_LETTER + 22)
 
 int keyboard_getchar();
 
@@ -0,0 +1,161 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "serial.h"
+#include "io.h"
+#include "interrupts.h"
+
+#define COM1            0x3F8
+#define COM1_IRQ        4
+#define UART_DATA       (COM1 + 0)
+#define UART_IER        (COM1 + 1)
+#define UART_IIR        (COM1 + 2)
+#define UART_FCR        (COM1 + 2)
+#define UART_LCR        (COM1 + 3)
+#define UART_MCR        (COM1 + 4)
+#define UART_LSR        (COM1 + 5)
+#define UART_MSR        (COM1 + 6)
+#define UART_SCRATCH    (COM1 + 7)
+#define UART_FIFO_SIZE  16
+#define IER_RX          0x01
+#define IER_TX          0x02
+#define LSR_RX_READY    0x01
+#define LSR_THR_EMPTY   0x20
+#define LSR_IDLE        0x40
+#define SERIAL_RX_SIZE  1024
+#define SERIAL_TX_SIZE  8192
+
+static int present = 0;
+static uint8_t rx_ring[SERIAL_RX_SIZE];
+static uint8_t tx_ring[SERIAL_TX_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile uint8_t ier = 0;
+static uint32_t dropped = 0;
+
+static void fill_fifo(void) {
+    int n = 0;
+    while (n < UART_FIFO_SIZE && tx_tail != tx_head) {
+        outb(UART_DATA, tx_ring[tx_tail % SERIAL_TX_SIZE]);
+        tx_tail++;
+        n++;
+    }
+    if (tx_tail == tx_head) {
+        ier &= ~IER_TX;
+    } else {
+        ier |= IER_TX;
+    }
+    outb(UART_IER, ier);
+}
+
+static void serial_irq(void) {
+    uint8_t iir;
+    while (!((iir = inb(UART_IIR)) & 0x01)) {
+        switch (iir & 0x0E) {
+            case 0x04:
+            case 0x0C:
+                while (inb(UART_LSR) & LSR_RX_READY) {
+                    uint8_t c = inb(UART_DATA);
+                    if (rx_head - rx_tail < SERIAL_RX_SIZE) {
+                        rx_ring[rx_head % SERIAL_RX_SIZE] = c;
+                        rx_head++;
+                    }
+                }
+                break;
+            case 0x02:
+                fill_fifo();
+                break;
+            case 0x06:
+                inb(UART_LSR);
+                break;
+            default:
+                inb(UART_MSR);
+                break;
+        }
+    }
+}
+
+void serial_init(void) {
+    outb(UART_SCRATCH, 0xA5);
+    if (inb(UART_SCRATCH) != 0xA5) return;
+
+    outb(UART_IER, 0x00);
+    outb(UART_LCR, 0x80);
+    outb(UART_DATA, 0x01);
+    outb(UART_IER, 0x00);
+    outb(UART_LCR, 0x03);
+    outb(UART_FCR, 0xC7);
+    outb(UART_MCR, 0x0B);
+    inb(UART_LSR);
+    inb(UART_DATA);
+
+    present = 1;
+    irq_register(COM1_IRQ, serial_irq);
+    ier = IER_RX;
+    outb(UART_IER, ier);
+}
+
+int serial_present(void) {
+    return present;
+}
+
+void serial_write(const char *buf, int len) {
+    if (!present) return;
+    for (int i = 0; i < len; i++) {
+        if (tx_head - tx_tail >= SERIAL_TX_SIZE) {
+            dropped += len - i;
+            break;
+        }
+        tx_ring[tx_head % SERIAL_TX_SIZE] = (uint8_t)buf[i];
+        tx_head++;
+    }
+    if (!(ier & IER_TX)) {
+        uint32_t flags = irq_save();
+        if (inb(UART_LSR) & LSR_THR_EMPTY) {
+            fill_fifo();
+        } else {
+            ier |= IER_TX;
+            outb(UART_IER, ier);
+        }
+        irq_restore(flags);
+    }
+}
+
+int serial_getchar(void) {
+    if (rx_tail == rx_head) return -1;
+    uint8_t c = rx_ring[rx_tail % SERIAL_RX_SIZE];
+    rx_tail++;
+    return c;
+}
+
+void serial_flush(void) {
+    if (!present) return;
+    while (tx_tail != tx_head) {
+        uint32_t flags = irq_save();
+        if (inb(UART_LSR) & LSR_THR_EMPTY) fill_fifo();
+        irq_restore(flags);
+    }
+    while (!(inb(UART_LSR) & LSR_IDLE));
+}
+
+uint32_t serial_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,104 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "timer.h"
+#include "io.h"
+#include "div64.h"
+
+#define PIT_FREQUENCY     1193182
+#define PIT_CHANNEL2      0x42
+#define PIT_COMMAND       0x43
+#define PIT_GATE_PORT     0x61
+#define CALIBRATE_MS      10
+
+static int tsc_available = 0;
+static uint32_t tsc_khz = 0;
+static uint64_t boot_tsc = 0;
+
+static int cpuid_available(void) {
+    uint32_t before, after;
+    __asm__ volatile (
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %1\n\t"
+        "pushl %1\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %1\n\t"
+        "pushl %0\n\t"
+        "popfl"
+        : "=&r"(before), "=&r"(after) : : "cc");
+    return ((before ^ after) & 0x200000) != 0;
+}
+
+static uint32_t cpuid_features(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return edx;
+}
+
+uint64_t timer_read_tsc(void) {
+    uint32_t lo, hi;
+    if (!tsc_available) return 0;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint32_t calibrate_tsc(void) {
+    uint16_t count = PIT_FREQUENCY / (1000 / CALIBRATE_MS);
+    uint8_t gate = inb(PIT_GATE_PORT);
+
+    outb(PIT_GATE_PORT, gate & ~0x03);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, count >> 8);
+
+    uint64_t start = timer_read_tsc();
+    outb(PIT_GATE_PORT, (gate & ~0x02) | 0x01);
+    while (!(inb(PIT_GATE_PORT) & 0x20));
+    uint64_t end = timer_read_tsc();
+
+    outb(PIT_GATE_PORT, gate);
+    return (uint32_t)udiv64_32(end - start, CALIBRATE_MS, NULL);
+}
+
+void timer_init(void) {
+    tsc_available = cpuid_available() && (cpuid_features() & 0x10);
+    if (!tsc_available) return;
+    boot_tsc = timer_read_tsc();
+    tsc_khz = calibrate_tsc();
+}
+
+uint64_t timer_boot_tsc(void) {
+    return boot_tsc;
+}
+
+int timer_has_tsc(void) {
+    return tsc_available;
+}
+
+uint32_t timer_tsc_khz(void) {
+    return tsc_khz;
+}
+
+uint64_t timer_cycles_to_us(uint64_t cycles) {
+    if (tsc_khz == 0) return 0;
+    return udiv64_32(cycles * 1000, tsc_khz, NULL);
+}
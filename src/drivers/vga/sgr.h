@@ -0,0 +1,60 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ANSI SGR parameters to VGA attribute colours, shared by the in-kernel VT
+ * parser and the host-side banner generator so both render banner.txt the
+ * same way. Only depends on <stdint.h>.
+ */
+
+#ifndef SGR_H
+#define SGR_H
+
+#include <stdint.h>
+
+#define SGR_DEFAULT_FG 0x7
+#define SGR_DEFAULT_BG 0x0
+
+static const uint8_t sgr_colors[8] = { 0x0, 0x4, 0x2, 0x6, 0x1, 0x5, 0x3, 0x7 };
+
+static inline void sgr_apply(int attr, uint8_t *fg, uint8_t *bg) {
+    if (attr == 0) {
+        *fg = SGR_DEFAULT_FG;
+        *bg = SGR_DEFAULT_BG;
+    } else if (attr == 7) {
+        uint8_t temp = *fg;
+        *fg = *bg;
+        *bg = temp;
+    } else if (attr == 8) {
+        *fg = *bg;
+    } else if (attr >= 30 && attr <= 37) {
+        *fg = sgr_colors[attr - 30];
+    } else if (attr == 39) {
+        *fg = SGR_DEFAULT_FG;
+    } else if (attr >= 40 && attr <= 47) {
+        *bg = sgr_colors[attr - 40];
+    } else if (attr == 49) {
+        *bg = SGR_DEFAULT_BG;
+    } else if (attr >= 90 && attr <= 97) {
+        *fg = sgr_colors[attr - 90] | 0x08;
+    } else if (attr >= 100 && attr <= 107) {
+        *bg = sgr_colors[attr - 100] | 0x08;
+    }
+}
+
+#endif
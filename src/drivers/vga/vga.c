@@ -16,19 +16,118 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
  
+#include <stddef.h>
 #include <stdint.h>
 #include "vga.h"
+#include "sgr.h"
 #include "keyboard.h"
+#include "serial.h"
+#include "latency.h"
 
 #define VGA_MEMORY ((uint16_t*)0xB8000)
-#define SCREEN_WIDTH 80
-#define SCREEN_HEIGHT 25
-#define SCREEN_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT)
+#define MAX_SCREEN_WIDTH 90
+#define MAX_SCREEN_HEIGHT 60
+#define SCROLLBACK_LINES 200
+#define VGA_WINDOW_CELLS 16384
+#define VT_MAX_PARAMS 8
+#define VGA_CONSOLES 4
+
+static int screen_width = 80;
+static int screen_height = 25;
+static int screen_size = 80 * 25;
+static uint8_t cursor_end_line = 0x0F;
 
 static int vga_cursor_x = 0;
 static int vga_cursor_y = 0;
 static uint8_t current_fg = COLOR_WHITE;
 static uint8_t current_bg = COLOR_BLACK;
+static vga_sink_t output_sink = { NULL, NULL };
+static vga_sink_t error_saved_sink = { NULL, NULL };
+static uint8_t error_saved_fg = COLOR_WHITE;
+static uint8_t error_saved_bg = COLOR_BLACK;
+static uint32_t chars_written = 0;
+
+#define RING_ROWS (SCROLLBACK_LINES + MAX_SCREEN_HEIGHT)
+
+/* Each console's screen and its scrollback share one ring of rows: the
+ * screen is the screen_height rows from shadow_top on and the history is
+ * the SCROLLBACK_LINES rows before it, so scrolling only moves shadow_top. */
+static uint16_t console_shadow[VGA_CONSOLES][RING_ROWS * MAX_SCREEN_WIDTH];
+static uint8_t console_row_dirty[VGA_CONSOLES][RING_ROWS];
+
+static int ring_rows = SCROLLBACK_LINES + 25;
+static int scrollback_count = 0;
+static int scrollback_view = 0;
+
+static uint16_t *shadow = console_shadow[0];
+static uint8_t *row_dirty = console_row_dirty[0];
+static int any_dirty = 0;
+static int shadow_top = 0;
+static int display_start = 0;
+static int hw_display_start = 0;
+static int active_console = 0;
+static int page_base = 0;
+static int page_cells = VGA_WINDOW_CELLS / VGA_CONSOLES;
+static int cursor_visible = 0;
+static int cursor_pos = 0;
+
+static int mirror_enabled = 1;
+static int mirror_color = -1;
+static int mirror_pos = -1;
+static const uint8_t ansi_colors[16] = {
+    30, 34, 32, 36, 31, 35, 33, 37, 90, 94, 92, 96, 91, 95, 93, 97
+};
+
+enum { VT_GROUND, VT_ESCAPE, VT_CSI, VT_STATES };
+enum { VT_C_ESC, VT_C_BRACKET, VT_C_DIGIT, VT_C_SEP, VT_C_PRIVATE, VT_C_FINAL, VT_C_OTHER, VT_CLASSES };
+enum { VT_NONE, VT_PRINT, VT_CLEAR, VT_PARAM, VT_NEXT_PARAM, VT_MARK_PRIVATE, VT_ESC_DISPATCH, VT_CSI_DISPATCH };
+
+#define VT(action, next) ((action) | ((next) << 4))
+
+static const uint8_t vt_table[VT_STATES][VT_CLASSES] = {
+    [VT_GROUND] = {
+        VT(VT_NONE, VT_ESCAPE), VT(VT_PRINT, VT_GROUND), VT(VT_PRINT, VT_GROUND), VT(VT_PRINT, VT_GROUND),
+        VT(VT_PRINT, VT_GROUND), VT(VT_PRINT, VT_GROUND), VT(VT_PRINT, VT_GROUND)
+    },
+    [VT_ESCAPE] = {
+        VT(VT_NONE, VT_ESCAPE), VT(VT_CLEAR, VT_CSI), VT(VT_ESC_DISPATCH, VT_GROUND), VT(VT_NONE, VT_GROUND),
+        VT(VT_NONE, VT_GROUND), VT(VT_ESC_DISPATCH, VT_GROUND), VT(VT_PRINT, VT_GROUND)
+    },
+    [VT_CSI] = {
+        VT(VT_NONE, VT_ESCAPE), VT(VT_NONE, VT_GROUND), VT(VT_PARAM, VT_CSI), VT(VT_NEXT_PARAM, VT_CSI),
+        VT(VT_MARK_PRIVATE, VT_CSI), VT(VT_CSI_DISPATCH, VT_GROUND), VT(VT_NONE, VT_CSI)
+    }
+};
+
+typedef struct {
+    uint8_t state;
+    uint8_t private_mode;
+    uint8_t param_count;
+    uint16_t params[VT_MAX_PARAMS];
+    int saved_x;
+    int saved_y;
+    uint8_t saved_fg;
+    uint8_t saved_bg;
+} vt_parser_t;
+
+static vt_parser_t vt = { VT_GROUND, 0, 0, {0}, 0, 0, COLOR_WHITE, COLOR_BLACK };
+
+/* Per-console copies of the scalar state above; the buffers are switched by
+ * pointer. Console 0 is live from boot, the others start on first use. */
+typedef struct {
+    int initialized;
+    int cursor_x;
+    int cursor_y;
+    uint8_t fg;
+    uint8_t bg;
+    int any_dirty;
+    int shadow_top;
+    int display_start;
+    int scrollback_count;
+    vt_parser_t vt;
+} console_state_t;
+
+static console_state_t console_states[VGA_CONSOLES] = { { 1, 0, 0, 0, 0, 0, 0, 0, 0, { 0 } } };
 
 static uint8_t get_vga_color() {
     return VGA_COLOR(current_fg, current_bg);
@@ -44,11 +143,58 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+/* Negative rows reach back into the scrollback. */
+static inline int shadow_slot(int row) {
+    int slot = shadow_top + row;
+    if (slot < 0) return slot + ring_rows;
+    return slot >= ring_rows ? slot - ring_rows : slot;
+}
+
+static inline uint16_t *shadow_row(int row) {
+    return &shadow[shadow_slot(row) * screen_width];
+}
+
+static inline uint16_t *screen_row(int row) {
+    return &VGA_MEMORY[page_base + display_start + row * screen_width];
+}
+
+static inline void mark_dirty(int row) {
+    row_dirty[shadow_slot(row)] = 1;
+    any_dirty = 1;
+}
+
+static void mark_all_dirty(void) {
+    for (int row = 0; row < screen_height; row++) row_dirty[shadow_slot(row)] = 1;
+    any_dirty = 1;
+}
+
+static void copy_row(uint16_t *dst, const uint16_t *src) {
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    for (int i = 0; i < screen_width / 2; i++) d[i] = s[i];
+}
+
+static void set_display_start(int start) {
+    outb(0x3D4, 0x0C);
+    outb(0x3D5, (uint8_t)((start >> 8) & 0xFF));
+    outb(0x3D4, 0x0D);
+    outb(0x3D5, (uint8_t)(start & 0xFF));
+    hw_display_start = start;
+}
+
+/* The cursor is placed relative to the start address the CRTC is showing,
+ * which lags display_start until the next flush; vga_flush places it again
+ * when it moves the start address. */
 void set_cursor(int position) {
-    outb(0x3D4, 0x0A);
-    outb(0x3D5, 0x00);
-    outb(0x3D4, 0x0B);
-    outb(0x3D5, 0x0F);
+    cursor_pos = position;
+    position += hw_display_start;
+    if (!cursor_visible) {
+        outb(0x3D4, 0x0A);
+        outb(0x3D5, 0x00);
+        outb(0x3D4, 0x0B);
+        outb(0x3D5, cursor_end_line);
+        cursor_visible = 1;
+    }
 
     outb(0x3D4, 0x0F);
     outb(0x3D5, (uint8_t)(position & 0xFF));
@@ -57,67 +203,382 @@ void set_cursor(int position) {
     outb(0x3D5, (uint8_t)((position >> 8) & 0xFF));
 }
 
-void scroll_screen() {
-    for (int row = 1; row < SCREEN_HEIGHT; row++) {
-        for (int col = 0; col < SCREEN_WIDTH; col++) {
-            VGA_MEMORY[(row - 1) * SCREEN_WIDTH + col] =
-                VGA_MEMORY[row * SCREEN_WIDTH + col];
+void vga_flush(void) {
+    if (!any_dirty || scrollback_view) return;
+    for (int row = 0; row < screen_height; row++) {
+        int slot = shadow_slot(row);
+        if (!row_dirty[slot]) continue;
+        copy_row(screen_row(row), &shadow[slot * screen_width]);
+        row_dirty[slot] = 0;
+    }
+    any_dirty = 0;
+    latency_glyph_drawn();
+    if (page_base + display_start != hw_display_start) {
+        set_display_start(page_base + display_start);
+        set_cursor(cursor_pos);
+    }
+}
+
+static int format_number(char *out, int value) {
+    char digits[8];
+    int n = 0, len = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) out[len++] = digits[--n];
+    return len;
+}
+
+static int mirror_active(void) {
+    return mirror_enabled && serial_present();
+}
+
+static void mirror_text(const char *buf, size_t len, uint8_t color) {
+    char seq[64];
+    int n = 0;
+    if (!mirror_active()) return;
+    if (color != mirror_color) {
+        seq[n++] = '\033';
+        seq[n++] = '[';
+        n += format_number(seq + n, ansi_colors[color & 0x0F]);
+        seq[n++] = ';';
+        n += format_number(seq + n, ansi_colors[color >> 4] + 10);
+        seq[n++] = 'm';
+        mirror_color = color;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
+        if (n > (int)sizeof(seq) - 3) {
+            serial_write(seq, n);
+            n = 0;
+        }
+        if (c == '\n') {
+            seq[n++] = '\r';
+            seq[n++] = '\n';
+        } else if (c == '\b') {
+            seq[n++] = '\b';
+            seq[n++] = ' ';
+            seq[n++] = '\b';
+        } else {
+            seq[n++] = c;
         }
     }
+    serial_write(seq, n);
+}
 
-    uint8_t color_byte = get_vga_color();
-    for (int col = 0; col < SCREEN_WIDTH; col++) {
-        VGA_MEMORY[(SCREEN_HEIGHT - 1) * SCREEN_WIDTH + col] =
-            ' ' | (color_byte << 8);
+static void mirror_cursor(int pos) {
+    char seq[16];
+    int n = 0;
+    if (!mirror_active() || pos == mirror_pos) return;
+    seq[n++] = '\033';
+    seq[n++] = '[';
+    n += format_number(seq + n, pos / screen_width + 1);
+    seq[n++] = ';';
+    n += format_number(seq + n, pos % screen_width + 1);
+    seq[n++] = 'H';
+    serial_write(seq, n);
+    mirror_pos = pos;
+}
+
+static void mirror_clear(void) {
+    char seq[16];
+    int n = 0;
+    if (!mirror_active()) return;
+    seq[n++] = '\033';
+    seq[n++] = '[';
+    seq[n++] = '1';
+    seq[n++] = ';';
+    n += format_number(seq + n, screen_height);
+    seq[n++] = 'r';
+    serial_write(seq, n);
+    serial_write("\033[0m\033[2J\033[H", 11);
+    mirror_color = -1;
+    mirror_pos = 0;
+}
+
+static void hide_cursor(void) {
+    outb(0x3D4, 0x0A);
+    outb(0x3D5, 0x20);
+    cursor_visible = 0;
+}
+
+/* Scrolling advances the ring head, which turns the top row into history
+ * without copying it, and moves the CRTC start address down a row, so only
+ * the exposed row has to be written. When the start address would run off
+ * the end of the console's page, the whole screen is redrawn at the top of
+ * the page instead; other consoles' pages are never touched. */
+static void scroll_up(void) {
+    shadow_top = shadow_slot(1);
+    if (scrollback_count < SCROLLBACK_LINES) scrollback_count++;
+
+    uint16_t *bottom = shadow_row(screen_height - 1);
+    uint16_t blank = ' ' | (get_vga_color() << 8);
+    for (int col = 0; col < screen_width; col++) bottom[col] = blank;
+
+    display_start += screen_width;
+    if (display_start + screen_size > page_cells) {
+        display_start = 0;
+        mark_all_dirty();
+    } else {
+        mark_dirty(screen_height - 1);
     }
 }
 
-void putchar(char c) {
+void scroll_screen() {
+    scroll_up();
+    vga_flush();
+}
+
+static void write_chars(const char *buf, size_t len) {
     uint8_t color_byte = get_vga_color();
-    int current_linear_pos;
-
-    if (c == '\n') {
-        vga_cursor_x = 0;
-        vga_cursor_y++;
-    } else if (c == '\b') {
-        if (vga_cursor_x > 0) {
-            vga_cursor_x--;
-        } else if (vga_cursor_y > 0) {
-            vga_cursor_y--;
-            vga_cursor_x = SCREEN_WIDTH - 1;
+    uint16_t attr = (uint16_t)color_byte << 8;
+
+    if (scrollback_view) vga_scroll_view_reset();
+    mirror_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+    chars_written += len;
+
+    uint16_t *row = shadow_row(vga_cursor_y);
+    mark_dirty(vga_cursor_y);
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
+        if (c == '\n') {
+            vga_cursor_x = 0;
+            vga_cursor_y++;
+        } else if (c == '\b') {
+            if (vga_cursor_x > 0) {
+                vga_cursor_x--;
+            } else if (vga_cursor_y > 0) {
+                vga_cursor_y--;
+                vga_cursor_x = screen_width - 1;
+                row = shadow_row(vga_cursor_y);
+                mark_dirty(vga_cursor_y);
+            }
+            row[vga_cursor_x] = ' ' | attr;
+            continue;
+        } else {
+            row[vga_cursor_x++] = (uint8_t)c | attr;
+            if (vga_cursor_x < screen_width) continue;
+            vga_cursor_x = 0;
+            vga_cursor_y++;
+        }
+
+        if (vga_cursor_y >= screen_height) {
+            scroll_up();
+            vga_cursor_y = screen_height - 1;
         }
-        VGA_MEMORY[vga_cursor_y * SCREEN_WIDTH + vga_cursor_x] = ' ' | (color_byte << 8);
+        row = shadow_row(vga_cursor_y);
+        mark_dirty(vga_cursor_y);
+    }
+
+    mirror_text(buf, len, color_byte);
+    mirror_pos = vga_cursor_y * screen_width + vga_cursor_x;
+}
+
+static void erase_cells(int start, int end) {
+    uint16_t blank = ' ' | ((uint16_t)get_vga_color() << 8);
+    for (int row = start / screen_width; row * screen_width < end; row++) {
+        uint16_t *cells = shadow_row(row);
+        int from = row * screen_width < start ? start - row * screen_width : 0;
+        int to = (row + 1) * screen_width > end ? end - row * screen_width : screen_width;
+        for (int col = from; col < to; col++) cells[col] = blank;
+        mark_dirty(row);
+    }
+}
+
+static void mirror_erase(int mode, char command) {
+    char seq[8];
+    int n = 0;
+    if (!mirror_active()) return;
+    mirror_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+    mirror_text("", 0, get_vga_color());
+    seq[n++] = '\033';
+    seq[n++] = '[';
+    n += format_number(seq + n, mode);
+    seq[n++] = command;
+    serial_write(seq, n);
+}
+
+static int vt_param(int index, int fallback) {
+    if (index >= vt.param_count || vt.params[index] == 0) return fallback;
+    return vt.params[index];
+}
+
+static void vt_move_cursor(int x, int y) {
+    if (x < 0) x = 0;
+    if (x >= screen_width) x = screen_width - 1;
+    if (y < 0) y = 0;
+    if (y >= screen_height) y = screen_height - 1;
+    vga_cursor_x = x;
+    vga_cursor_y = y;
+}
+
+static void vt_save_cursor(void) {
+    vt.saved_x = vga_cursor_x;
+    vt.saved_y = vga_cursor_y;
+    vt.saved_fg = current_fg;
+    vt.saved_bg = current_bg;
+}
+
+static void vt_restore_cursor(void) {
+    vt_move_cursor(vt.saved_x, vt.saved_y);
+    current_fg = vt.saved_fg;
+    current_bg = vt.saved_bg;
+}
+
+static void vt_select_graphic_rendition(void) {
+    int count = vt.param_count ? vt.param_count : 1;
+    for (int i = 0; i < count; i++) {
+        sgr_apply(i < vt.param_count ? vt.params[i] : 0, &current_fg, &current_bg);
+    }
+}
+
+static void vt_erase(int mode, int line_only) {
+    int cursor = vga_cursor_y * screen_width + vga_cursor_x;
+    int first = line_only ? vga_cursor_y * screen_width : 0;
+    int last = line_only ? first + screen_width : screen_size;
+    if (mode == 0) {
+        erase_cells(cursor, last);
+    } else if (mode == 1) {
+        erase_cells(first, cursor + 1);
+    } else if (mode == 2) {
+        erase_cells(first, last);
     } else {
-        VGA_MEMORY[vga_cursor_y * SCREEN_WIDTH + vga_cursor_x] = c | (color_byte << 8);
-        vga_cursor_x++;
+        return;
     }
+    mirror_erase(mode, line_only ? 'K' : 'J');
+}
 
-    if (vga_cursor_x >= SCREEN_WIDTH) {
-        vga_cursor_x = 0;
-        vga_cursor_y++;
+static void vt_csi_dispatch(char command) {
+    if (vt.private_mode) return;
+    switch (command) {
+        case 'A': vt_move_cursor(vga_cursor_x, vga_cursor_y - vt_param(0, 1)); break;
+        case 'B': vt_move_cursor(vga_cursor_x, vga_cursor_y + vt_param(0, 1)); break;
+        case 'C': vt_move_cursor(vga_cursor_x + vt_param(0, 1), vga_cursor_y); break;
+        case 'D': vt_move_cursor(vga_cursor_x - vt_param(0, 1), vga_cursor_y); break;
+        case 'G': vt_move_cursor(vt_param(0, 1) - 1, vga_cursor_y); break;
+        case 'd': vt_move_cursor(vga_cursor_x, vt_param(0, 1) - 1); break;
+        case 'H':
+        case 'f': vt_move_cursor(vt_param(1, 1) - 1, vt_param(0, 1) - 1); break;
+        case 'J': vt_erase(vt_param(0, 0), 0); break;
+        case 'K': vt_erase(vt_param(0, 0), 1); break;
+        case 'm': vt_select_graphic_rendition(); break;
+        case 's': vt_save_cursor(); break;
+        case 'u': vt_restore_cursor(); break;
+        default: break;
     }
+}
+
+static void vt_feed(char c) {
+    uint8_t byte = (uint8_t)c;
+    uint8_t class;
+    if (byte == 0x1B) class = VT_C_ESC;
+    else if (byte == '[') class = VT_C_BRACKET;
+    else if (byte >= '0' && byte <= '9') class = VT_C_DIGIT;
+    else if (byte == ';') class = VT_C_SEP;
+    else if (byte >= 0x3C && byte <= 0x3F) class = VT_C_PRIVATE;
+    else if (byte >= 0x40 && byte <= 0x7E) class = VT_C_FINAL;
+    else class = VT_C_OTHER;
+
+    uint8_t entry = vt_table[vt.state][class];
+    vt.state = entry >> 4;
 
-    if (vga_cursor_y >= SCREEN_HEIGHT) {
-        scroll_screen();
-        vga_cursor_y = SCREEN_HEIGHT - 1;
+    switch (entry & 0x0F) {
+        case VT_PRINT:
+            write_chars(&c, 1);
+            break;
+        case VT_CLEAR:
+            vt.param_count = 0;
+            vt.private_mode = 0;
+            vt.params[0] = 0;
+            break;
+        case VT_PARAM:
+            if (vt.param_count == 0) vt.param_count = 1;
+            if (vt.param_count <= VT_MAX_PARAMS) {
+                uint16_t *param = &vt.params[vt.param_count - 1];
+                if (*param < 10000) *param = *param * 10 + (byte - '0');
+            }
+            break;
+        case VT_NEXT_PARAM:
+            if (vt.param_count == 0) vt.param_count = 1;
+            if (vt.param_count < VT_MAX_PARAMS) vt.params[vt.param_count] = 0;
+            vt.param_count++;
+            break;
+        case VT_MARK_PRIVATE:
+            vt.private_mode = 1;
+            break;
+        case VT_ESC_DISPATCH:
+            if (c == '7') vt_save_cursor();
+            else if (c == '8') vt_restore_cursor();
+            break;
+        case VT_CSI_DISPATCH:
+            if (vt.param_count > VT_MAX_PARAMS) vt.param_count = VT_MAX_PARAMS;
+            vt_csi_dispatch(c);
+            break;
+        default:
+            break;
     }
+}
 
-    current_linear_pos = vga_cursor_y * SCREEN_WIDTH + vga_cursor_x;
-    set_cursor(current_linear_pos);
+/* Plain text between escape sequences is handed to write_chars as a whole
+ * run; only escape sequences go through the state machine byte by byte. */
+static void write_terminal(const char *buf, size_t len) {
+    size_t i = 0;
+    if (scrollback_view) vga_scroll_view_reset();
+    while (i < len) {
+        if (vt.state == VT_GROUND) {
+            size_t run = i;
+            while (run < len && buf[run] != '\033') run++;
+            if (run > i) {
+                write_chars(buf + i, run - i);
+                i = run;
+                continue;
+            }
+        }
+        vt_feed(buf[i++]);
+    }
+}
+
+void vga_write(const char *buf, size_t len) {
+    if (output_sink.write) {
+        output_sink.write(output_sink.ctx, buf, (int)len);
+        return;
+    }
+    if (len == 0) return;
+    write_terminal(buf, len);
+    set_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+    vga_flush();
+}
+
+void putchar(char c) {
+    if (output_sink.write) {
+        output_sink.write(output_sink.ctx, &c, 1);
+        return;
+    }
+    write_terminal(&c, 1);
+    set_cursor(vga_cursor_y * screen_width + vga_cursor_x);
 }
 
 void print(const char* str) {
-    while (*str) putchar(*str++);
+    size_t len = 0;
+    while (str[len]) len++;
+    vga_write(str, len);
 }
 
 void clear_screen() {
     uint8_t color_byte = get_vga_color();
-    for (int i = 0; i < SCREEN_SIZE; i++) {
-        VGA_MEMORY[i] = ' ' | (color_byte << 8);
+    if (scrollback_view) vga_scroll_view_reset();
+    for (int row = 0; row < screen_height; row++) {
+        uint16_t *cells = shadow_row(row);
+        for (int col = 0; col < screen_width; col++) cells[col] = ' ' | (color_byte << 8);
     }
+    display_start = 0;
+    mark_all_dirty();
+    vga_flush();
     vga_cursor_x = 0;
     vga_cursor_y = 0;
     set_cursor(0);
+    mirror_clear();
 }
 
 void backspace() {
@@ -125,17 +586,18 @@ void backspace() {
 }
 
 int get_cursor() {
-    return vga_cursor_y * SCREEN_WIDTH + vga_cursor_x;
+    return vga_cursor_y * screen_width + vga_cursor_x;
 }
 
 void set_cursor_pos(int pos) {
     if (pos < 0) pos = 0;
-    if (pos >= SCREEN_SIZE) pos = SCREEN_SIZE - 1;
+    if (pos >= screen_size) pos = screen_size - 1;
 
-    vga_cursor_x = pos % SCREEN_WIDTH;
-    vga_cursor_y = pos / SCREEN_WIDTH;
+    vga_cursor_x = pos % screen_width;
+    vga_cursor_y = pos / screen_width;
 
     set_cursor(pos);
+    mirror_cursor(pos);
 }
 
 void set_text_color(uint8_t fg, uint8_t bg) {
@@ -144,19 +606,336 @@ void set_text_color(uint8_t fg, uint8_t bg) {
 }
 
 int get_screen_width() {
-    return SCREEN_WIDTH;
+    return screen_width;
 }
 
 int get_screen_height() {
-    return SCREEN_HEIGHT;
+    return screen_height;
 }
 
 void vga_clear_chars(int start_pos, int count) {
-    uint8_t color_byte = get_vga_color();
+    if (scrollback_view) vga_scroll_view_reset();
     int end_pos = start_pos + count;
-    if (end_pos > SCREEN_SIZE) end_pos = SCREEN_SIZE;
+    if (end_pos > screen_size) end_pos = screen_size;
+    if (start_pos >= end_pos) return;
+
+    erase_cells(start_pos, end_pos);
+    vga_flush();
+
+    if (mirror_active()) {
+        mirror_cursor(start_pos);
+        for (int i = start_pos; i < end_pos; i++) mirror_text(" ", 1, get_vga_color());
+        mirror_pos = -1;
+    }
+}
+
+static void mirror_cells(int row, const uint16_t *cells) {
+    char text[MAX_SCREEN_WIDTH];
+    int start = 0;
+    mirror_cursor(row * screen_width);
+    for (int col = 0; col < screen_width; col++) text[col] = (char)(cells[col] & 0xFF);
+    for (int col = 1; col <= screen_width; col++) {
+        if (col < screen_width && (cells[col] >> 8) == (cells[start] >> 8)) continue;
+        mirror_text(text + start, col - start, (uint8_t)(cells[start] >> 8));
+        start = col;
+    }
+    mirror_pos = -1;
+}
+
+void vga_blit_rows(int row, const uint16_t *cells, int width, int rows) {
+    if (output_sink.write) {
+        /* Redirected output gets the characters as text, one line per row. */
+        char line[MAX_SCREEN_WIDTH + 1];
+        int len_max = width < MAX_SCREEN_WIDTH ? width : MAX_SCREEN_WIDTH;
+        for (int i = 0; i < rows; i++) {
+            int len = 0;
+            for (int col = 0; col < len_max; col++) line[col] = (char)(cells[i * width + col] & 0xFF);
+            for (int col = 0; col < len_max; col++) {
+                if (line[col] != ' ') len = col + 1;
+            }
+            line[len++] = '\n';
+            output_sink.write(output_sink.ctx, line, len);
+        }
+        return;
+    }
+    if (scrollback_view) vga_scroll_view_reset();
+    if (row < 0 || row >= screen_height) return;
+    if (row + rows > screen_height) rows = screen_height - row;
+
+    uint16_t blank = ' ' | ((uint16_t)get_vga_color() << 8);
+    for (int i = 0; i < rows; i++) {
+        uint16_t *dst = shadow_row(row + i);
+        const uint16_t *src = cells + i * width;
+        if (width == screen_width) {
+            copy_row(dst, src);
+        } else {
+            for (int col = 0; col < screen_width; col++) dst[col] = col < width ? src[col] : blank;
+        }
+        mark_dirty(row + i);
+    }
+    vga_flush();
+
+    if (mirror_active()) {
+        for (int i = 0; i < rows; i++) mirror_cells(row + i, shadow_row(row + i));
+    }
+}
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t misc;
+    uint8_t seq[5];
+    uint8_t crtc[25];
+    uint8_t panning;
+} vga_mode_t;
+
+static const vga_mode_t modes[] = {
+    { 80, 25, 0x67, { 0x03, 0x00, 0x03, 0x00, 0x02 },
+      { 0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F, 0x00, 0x4F, 0x0D, 0x0E, 0x00,
+        0x00, 0x00, 0x50, 0x9C, 0x0E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF }, 0x08 },
+    { 80, 50, 0x67, { 0x03, 0x00, 0x03, 0x00, 0x02 },
+      { 0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F, 0x00, 0x47, 0x06, 0x07, 0x00,
+        0x00, 0x01, 0x40, 0x9C, 0x8E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF }, 0x08 },
+    { 90, 60, 0xE7, { 0x03, 0x01, 0x03, 0x00, 0x02 },
+      { 0x6B, 0x59, 0x5A, 0x82, 0x60, 0x8D, 0x0B, 0x3E, 0x00, 0x47, 0x06, 0x07, 0x00,
+        0x00, 0x00, 0x00, 0xEA, 0x0C, 0xDF, 0x2D, 0x08, 0xE8, 0x05, 0xA3, 0xFF }, 0x00 },
+};
+
+#define VGA_FONT ((volatile uint8_t *)0xA0000)
+#define FONT_GLYPHS 256
+#define FONT_STRIDE 32
+
+static uint8_t saved_font[FONT_GLYPHS * 16];
+static int saved_font_valid = 0;
+
+static void update_pages(void) {
+    if (screen_size <= VGA_WINDOW_CELLS / VGA_CONSOLES) {
+        page_cells = VGA_WINDOW_CELLS / VGA_CONSOLES;
+        page_base = active_console * page_cells;
+    } else {
+        page_cells = VGA_WINDOW_CELLS;
+        page_base = 0;
+    }
+}
+
+static void write_reg(uint16_t port, uint8_t index, uint8_t value) {
+    outb(port, index);
+    outb(port + 1, value);
+}
+
+/* Maps plane 2, where the font lives, at 0xA0000 while map is set. */
+static void font_access(int map) {
+    write_reg(0x3C4, 0x02, map ? 0x04 : 0x03);
+    write_reg(0x3C4, 0x04, map ? 0x07 : 0x03);
+    write_reg(0x3CE, 0x04, map ? 0x02 : 0x00);
+    write_reg(0x3CE, 0x05, map ? 0x00 : 0x10);
+    write_reg(0x3CE, 0x06, map ? 0x04 : 0x0E);
+}
+
+/* There is no 8x8 font in ROM we can reach from protected mode, so the
+ * 8x16 font loaded by the BIOS is kept and squeezed by OR-ing each pair of
+ * scanlines together. */
+static void load_font(int height) {
+    font_access(1);
+    if (!saved_font_valid) {
+        for (int glyph = 0; glyph < FONT_GLYPHS; glyph++) {
+            for (int line = 0; line < 16; line++) {
+                saved_font[glyph * 16 + line] = VGA_FONT[glyph * FONT_STRIDE + line];
+            }
+        }
+        saved_font_valid = 1;
+    }
+    for (int glyph = 0; glyph < FONT_GLYPHS; glyph++) {
+        const uint8_t *src = &saved_font[glyph * 16];
+        volatile uint8_t *dst = &VGA_FONT[glyph * FONT_STRIDE];
+        for (int line = 0; line < 16; line++) {
+            if (height == 16) dst[line] = src[line];
+            else dst[line] = line < 8 ? (uint8_t)(src[line * 2] | src[line * 2 + 1]) : 0;
+        }
+    }
+    font_access(0);
+}
 
-    for (int i = start_pos; i < end_pos; i++) {
-        VGA_MEMORY[i] = ' ' | (color_byte << 8);
+static void program_mode(const vga_mode_t *mode) {
+    outb(0x3C2, mode->misc);
+
+    write_reg(0x3C4, 0x00, 0x01);
+    for (int i = 1; i < 5; i++) write_reg(0x3C4, (uint8_t)i, mode->seq[i]);
+    write_reg(0x3C4, 0x00, 0x03);
+
+    write_reg(0x3D4, 0x03, mode->crtc[0x03] | 0x80);
+    write_reg(0x3D4, 0x11, mode->crtc[0x11] & 0x7F);
+    for (int i = 0; i < 25; i++) {
+        uint8_t value = mode->crtc[i];
+        if (i == 0x03) value |= 0x80;
+        if (i == 0x11) value &= 0x7F;
+        write_reg(0x3D4, (uint8_t)i, value);
+    }
+
+    inb(0x3DA);
+    outb(0x3C0, 0x13 | 0x20);
+    outb(0x3C0, mode->panning);
+}
+
+int vga_set_mode(int width, int height) {
+    const vga_mode_t *mode = NULL;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (modes[i].width == width && modes[i].height == height) mode = &modes[i];
+    }
+    if (!mode) return -1;
+
+    if (scrollback_view) vga_scroll_view_reset();
+    program_mode(mode);
+    load_font(height == 25 ? 16 : 8);
+
+    screen_width = width;
+    screen_height = height;
+    screen_size = width * height;
+    cursor_end_line = height == 25 ? 0x0F : 0x07;
+    cursor_visible = 0;
+    hw_display_start = 0;
+    ring_rows = SCROLLBACK_LINES + height;
+    update_pages();
+    for (int i = 0; i < VGA_CONSOLES; i++) {
+        console_states[i].initialized = 0;
+        console_states[i].shadow_top = 0;
+        console_states[i].scrollback_count = 0;
+    }
+    console_states[active_console].initialized = 1;
+    shadow_top = 0;
+    scrollback_count = 0;
+    clear_screen();
+    return 0;
+}
+
+static void save_console(int index) {
+    console_state_t *state = &console_states[index];
+    state->cursor_x = vga_cursor_x;
+    state->cursor_y = vga_cursor_y;
+    state->fg = current_fg;
+    state->bg = current_bg;
+    state->any_dirty = any_dirty;
+    state->shadow_top = shadow_top;
+    state->display_start = display_start;
+    state->scrollback_count = scrollback_count;
+    state->vt = vt;
+}
+
+static void load_console(int index) {
+    console_state_t *state = &console_states[index];
+    active_console = index;
+    shadow = console_shadow[index];
+    row_dirty = console_row_dirty[index];
+    update_pages();
+    vga_cursor_x = state->cursor_x;
+    vga_cursor_y = state->cursor_y;
+    current_fg = state->fg;
+    current_bg = state->bg;
+    any_dirty = state->any_dirty;
+    shadow_top = state->shadow_top;
+    display_start = state->display_start;
+    scrollback_count = state->scrollback_count;
+    vt = state->vt;
+}
+
+static void mirror_redraw(void) {
+    if (!mirror_active()) return;
+    mirror_clear();
+    for (int row = 0; row < screen_height; row++) mirror_cells(row, shadow_row(row));
+    mirror_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+}
+
+/* When every console's screen fits in its own quarter of the text window
+ * a switch only moves the CRTC start address. Larger modes share the whole
+ * window and the incoming console is redrawn from its shadow. */
+int vga_switch_console(int index) {
+    if (index < 0 || index >= VGA_CONSOLES) return -1;
+    if (index == active_console) return 0;
+    if (scrollback_view) vga_scroll_view_reset();
+    vga_flush();
+
+    save_console(active_console);
+    load_console(index);
+    if (!console_states[index].initialized) {
+        console_states[index].initialized = 1;
+        current_fg = COLOR_WHITE;
+        current_bg = COLOR_BLACK;
+        vt.state = VT_GROUND;
+        clear_screen();
+        return 0;
     }
-}
\ No newline at end of file
+    if (page_cells == VGA_WINDOW_CELLS) mark_all_dirty();
+    vga_flush();
+    if (page_base + display_start != hw_display_start) set_display_start(page_base + display_start);
+    set_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+    mirror_redraw();
+    return 0;
+}
+
+int vga_get_console(void) {
+    return active_console;
+}
+
+/* Turning the mirror back on forgets the terminal's colour and cursor, so
+ * the caller should redraw or clear the screen afterwards. */
+int vga_set_mirror(int enabled) {
+    int previous = mirror_enabled;
+    mirror_enabled = enabled;
+    mirror_color = -1;
+    mirror_pos = -1;
+    return previous;
+}
+
+/* Error text goes to the console in red even while output is redirected;
+ * vga_error_end puts back the sink and colours that were in use. */
+void vga_error_begin(void) {
+    vga_sink_t console = { NULL, NULL };
+    error_saved_sink = vga_set_sink(console);
+    error_saved_fg = current_fg;
+    error_saved_bg = current_bg;
+    set_text_color(COLOR_RED, COLOR_BLACK);
+}
+
+void vga_error_end(void) {
+    set_text_color(error_saved_fg, error_saved_bg);
+    vga_set_sink(error_saved_sink);
+}
+
+int vga_has_sink(void) {
+    return output_sink.write != NULL;
+}
+
+vga_sink_t vga_set_sink(vga_sink_t sink) {
+    vga_sink_t previous = output_sink;
+    output_sink = sink;
+    return previous;
+}
+
+uint32_t vga_get_chars_written(void) {
+    return chars_written;
+}
+
+void vga_scroll_view(int rows) {
+    int target = scrollback_view + rows;
+    if (target < 0) target = 0;
+    if (target > scrollback_count) target = scrollback_count;
+    if (target == scrollback_view) return;
+
+    if (scrollback_view == 0) vga_flush();
+    scrollback_view = target;
+
+    for (int row = 0; row < screen_height; row++) {
+        copy_row(screen_row(row), shadow_row(row - scrollback_view));
+    }
+    if (scrollback_view) {
+        hide_cursor();
+    } else {
+        for (int row = 0; row < screen_height; row++) row_dirty[shadow_slot(row)] = 0;
+        any_dirty = 0;
+        set_cursor(vga_cursor_y * screen_width + vga_cursor_x);
+    }
+}
+
+void vga_scroll_view_reset(void) {
+    vga_scroll_view(-scrollback_view);
+}
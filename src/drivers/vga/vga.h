@@ -19,6 +19,7 @@
 #ifndef VGA_H
 #define VGA_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define COLOR_BLACK         0x0
@@ -40,9 +41,17 @@
 
 #define VGA_COLOR(fg, bg) ((bg << 4) | (fg & 0x0F))
 
+typedef struct {
+    void (*write)(void *ctx, const char *buf, int len);
+    void *ctx;
+} vga_sink_t;
+
 void putchar(char c);
 void print(const char* str);
+void vga_write(const char *buf, size_t len);
+void vga_blit_rows(int row, const uint16_t *cells, int width, int rows);
 void clear_screen();
+void scroll_screen();
 void backspace();
 void set_cursor_pos(int pos);
 int get_cursor();
@@ -50,5 +59,17 @@ void set_text_color(uint8_t fg, uint8_t bg);
 int get_screen_width();
 int get_screen_height();
 void vga_clear_chars(int start_pos, int count);
+vga_sink_t vga_set_sink(vga_sink_t sink);
+int vga_has_sink(void);
+void vga_error_begin(void);
+void vga_error_end(void);
+int vga_set_mirror(int enabled);
+uint32_t vga_get_chars_written(void);
+void vga_scroll_view(int rows);
+void vga_scroll_view_reset(void);
+void vga_flush(void);
+int vga_set_mode(int width, int height);
+int vga_switch_console(int index);
+int vga_get_console(void);
 
 #endif 
@@ -0,0 +1,261 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bench.h"
+#include "vga.h"
+#include "ramdisk.h"
+#include "calc.h"
+#include "string.h"
+#include "timer.h"
+#include "div64.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "shell.h"
+
+#define BENCH_REPEATS 9
+#define BENCH_FILES 8
+#define BENCH_MAX 32
+
+typedef struct {
+    const char *name;
+    void (*run)(int arg, uint32_t iterations);
+    int arg;
+    uint32_t iterations;
+    void (*setup)(int arg);
+    void (*teardown)(int arg);
+    int draws;
+} bench_t;
+
+typedef struct {
+    const bench_t *bench;
+    uint64_t min;
+    uint64_t median;
+    uint64_t max;
+    int failed;
+} bench_result_t;
+
+static const char bench_text[] =
+    "The quick brown fox jumps over the lazy dog while cheese melts..";
+static char bench_text_copy[sizeof(bench_text)];
+static volatile uint32_t bench_sink;
+static int bench_failed;
+static char bench_names[BENCH_FILES][8];
+static bench_result_t results[BENCH_MAX];
+
+static void bench_putchar(int arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) putchar((char)('a' + i % 26));
+}
+
+static void bench_print(int arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) print(bench_text);
+}
+
+static void bench_scroll(int arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) scroll_screen();
+}
+
+static void bench_name_files(void) {
+    for (int i = 0; i < BENCH_FILES; i++) {
+        kstrcpy(bench_names[i], "~bench");
+        bench_names[i][6] = (char)('0' + i);
+        bench_names[i][7] = '\0';
+    }
+}
+
+static void bench_create_files(int count) {
+    bench_name_files();
+    for (int i = 0; i < count; i++) ramdisk_create_file(0, bench_names[i]);
+}
+
+static void bench_remove_files(int count) {
+    for (int i = 0; i < count; i++) ramdisk_remove_file(0, bench_names[i]);
+}
+
+static void bench_create(int arg, uint32_t iterations) {
+    (void)arg;
+    bench_name_files();
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (ramdisk_create_file(0, bench_names[i % BENCH_FILES]) != 0) bench_failed = 1;
+    }
+}
+
+static void bench_create_teardown(int arg) {
+    (void)arg;
+    bench_remove_files(BENCH_FILES);
+}
+
+static void bench_lookup_setup(int arg) {
+    (void)arg;
+    bench_create_files(BENCH_FILES);
+}
+
+static void bench_lookup(int arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        bench_sink += ramdisk_lookup(0, bench_names[BENCH_FILES - 1]) != NULL;
+    }
+}
+
+static void bench_write(int arg, uint32_t iterations) {
+    (void)arg;
+    ramdisk_inode_t *file = ramdisk_lookup(0, bench_names[0]);
+    for (uint32_t i = 0; i < iterations; i++) {
+        ramdisk_writefile(file, 0, RAMDISK_DATA_SIZE_BYTES, bench_text);
+    }
+}
+
+static void bench_lookup_teardown(int arg) {
+    (void)arg;
+    bench_remove_files(BENCH_FILES);
+}
+
+static void bench_mul(int arg, uint32_t iterations) {
+    calc_bench_mul(arg, iterations);
+}
+
+static void bench_divmod(int arg, uint32_t iterations) {
+    calc_bench_divmod(arg, iterations);
+}
+
+static void bench_powmod(int arg, uint32_t iterations) {
+    calc_bench_powmod(arg, iterations);
+}
+
+static void bench_strcmp(int arg, uint32_t iterations) {
+    (void)arg;
+    kstrcpy(bench_text_copy, bench_text);
+    for (uint32_t i = 0; i < iterations; i++) bench_sink += kstrcmp(bench_text, bench_text_copy);
+}
+
+static void bench_strlen(int arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) bench_sink += kstrlen(bench_text);
+}
+
+static const bench_t benches[] = {
+    {"putchar", bench_putchar, 0, 2000, NULL, NULL, 1},
+    {"print", bench_print, 0, 100, NULL, NULL, 1},
+    {"scroll_screen", bench_scroll, 0, 100, NULL, NULL, 1},
+    {"ramdisk_create_file", bench_create, 0, BENCH_FILES, NULL, bench_create_teardown, 0},
+    {"ramdisk_lookup", bench_lookup, 0, 1000, bench_lookup_setup, bench_lookup_teardown, 0},
+    {"ramdisk_writefile", bench_write, 0, 1000, bench_lookup_setup, bench_lookup_teardown, 0},
+    {"big32_mul/4", bench_mul, 4, 1000, NULL, NULL, 0},
+    {"big32_mul/16", bench_mul, 16, 100, NULL, NULL, 0},
+    {"big32_mul/64", bench_mul, 64, 10, NULL, NULL, 0},
+    {"big32_divmod/4", bench_divmod, 4, 100, NULL, NULL, 0},
+    {"big32_divmod/16", bench_divmod, 16, 10, NULL, NULL, 0},
+    {"big32_divmod/64", bench_divmod, 64, 2, NULL, NULL, 0},
+    {"big32_powmod/32", bench_powmod, 32, 1, NULL, NULL, 0},
+    {"kstrcmp", bench_strcmp, 0, 1000, NULL, NULL, 0},
+    {"kstrlen", bench_strlen, 0, 1000, NULL, NULL, 0},
+    {NULL, NULL, 0, 0, NULL, NULL, 0}
+};
+
+/* Drawing benches would otherwise mirror every cell to COM1 and overrun
+ * the transmit ring, so the mirror is off while they run. */
+static void bench_measure(const bench_t *bench, bench_result_t *result) {
+    uint64_t samples[BENCH_REPEATS];
+    int mirror = bench->draws ? vga_set_mirror(0) : 0;
+    bench_failed = 0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        if (bench->setup) bench->setup(bench->arg);
+        uint64_t start = timer_read_tsc();
+        bench->run(bench->arg, bench->iterations);
+        uint64_t end = timer_read_tsc();
+        if (bench->teardown) bench->teardown(bench->arg);
+
+        uint64_t per_op = udiv64_32(end - start, bench->iterations, NULL);
+        int i = r;
+        while (i > 0 && samples[i - 1] > per_op) {
+            samples[i] = samples[i - 1];
+            i--;
+        }
+        samples[i] = per_op;
+    }
+    if (bench->draws) vga_set_mirror(mirror);
+    result->bench = bench;
+    result->failed = bench_failed;
+    result->min = samples[0];
+    result->median = samples[BENCH_REPEATS / 2];
+    result->max = samples[BENCH_REPEATS - 1];
+}
+
+int bench_command(const char *args) {
+    if (!timer_has_tsc()) {
+        shell_error_begin();
+        print("bench needs a CPU with RDTSC\n");
+        shell_error_end();
+        return -1;
+    }
+
+    int count = 0;
+    int draws = 0;
+    size_t filter_len = args ? kstrlen(args) : 0;
+    for (int i = 0; benches[i].name != NULL && count < BENCH_MAX; i++) {
+        if (filter_len && kstrncmp(benches[i].name, args, filter_len) != 0) continue;
+        draws |= benches[i].draws;
+        bench_measure(&benches[i], &results[count++]);
+    }
+    if (count == 0) {
+        shell_error_begin();
+        print("No benchmark matches '");
+        print(args);
+        print("'\n");
+        shell_error_end();
+        return -1;
+    }
+
+    if (draws) {
+        serial_flush();
+        clear_screen();
+    }
+    kprintf("%-20s%12s%12s%12s  cycles/op\n", "benchmark", "min", "median", "max");
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (results[i].failed) {
+            shell_error_begin();
+            kprintf("%-20s%12s\n", results[i].bench->name, "failed");
+            shell_error_end();
+            failed = 1;
+            continue;
+        }
+        kprintf("%-20s%12llu%12llu%12llu\n", results[i].bench->name,
+                results[i].min, results[i].median, results[i].max);
+    }
+    return failed ? -1 : 0;
+}
+
+int bench_boot(uint64_t boot_cycles) {
+    const char *workload = (const char *)_binary_src_kernel_bench_workload_txt_start;
+    size_t len = (size_t)(_binary_src_kernel_bench_workload_txt_end - _binary_src_kernel_bench_workload_txt_start);
+    shell_script_result_t result;
+
+    kprintf("BENCH BEGIN\nboot cycles: %llu\nboot time:   %llu us\n",
+            boot_cycles, timer_cycles_to_us(boot_cycles));
+
+    shell_run_script(workload, len, SHELL_SCRIPT_ECHO, &result);
+
+    kprintf("BENCH END ran=%d failed=%d\n", result.ran, result.failed);
+    serial_flush();
+    return result.failed ? -1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "interrupts.h"
+#include "io.h"
+#include "vga.h"
+#include "kprintf.h"
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+#define PIC_EOI      0x20
+#define IRQ_BASE     0x20
+#define IDT_ENTRIES  256
+#define EXC_VECTORS  32
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t flags;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) descriptor_ptr_t;
+
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector, error;
+    uint32_t eip, cs, eflags;
+} exception_frame_t;
+
+extern void gdt_flush(const descriptor_ptr_t *gdt);
+extern const uint32_t exc_stub_table[EXC_VECTORS];
+extern const uint32_t irq_stub_table[16];
+
+static const uint64_t gdt[] = {
+    0x0000000000000000ULL,
+    0x00CF9A000000FFFFULL,
+    0x00CF92000000FFFFULL,
+};
+
+static const char *const exception_names[EXC_VECTORS] = {
+    "Divide error", "Debug", "NMI", "Breakpoint",
+    "Overflow", "Bound range", "Invalid opcode", "No FPU",
+    "Double fault", "FPU segment overrun", "Invalid TSS", "Segment not present",
+    "Stack fault", "General protection", "Page fault", "Reserved",
+    "FPU error", "Alignment check", "Machine check", "SIMD error",
+    "Virtualization", "Control protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "Hypervisor injection", "VMM communication", "Security", "Reserved",
+};
+
+static idt_entry_t idt[IDT_ENTRIES];
+static irq_handler_t irq_handlers[16];
+static uint16_t irq_mask = 0xFFFB;
+
+static void pic_write_mask(void) {
+    outb(PIC1_DATA, irq_mask & 0xFF);
+    outb(PIC2_DATA, irq_mask >> 8);
+}
+
+static void pic_remap(void) {
+    outb(PIC1_COMMAND, 0x11);
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, IRQ_BASE);
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);
+    outb(PIC2_DATA, 0x01);
+    pic_write_mask();
+}
+
+static void idt_set_gate(int vector, uint32_t handler) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = 0x08;
+    idt[vector].zero = 0;
+    idt[vector].flags = 0x8E;
+    idt[vector].offset_high = handler >> 16;
+}
+
+void exception_dispatch(const exception_frame_t *frame) {
+    vga_sink_t console = { NULL, NULL };
+    vga_set_sink(console);
+    set_text_color(COLOR_RED, COLOR_BLACK);
+    kprintf("\n%s exception (%u), error %x at %x:%x\n",
+            exception_names[frame->vector], frame->vector, frame->error, frame->cs, frame->eip);
+    kprintf("eax=%x ebx=%x ecx=%x edx=%x\n", frame->eax, frame->ebx, frame->ecx, frame->edx);
+    kprintf("esi=%x edi=%x ebp=%x eflags=%x\n", frame->esi, frame->edi, frame->ebp, frame->eflags);
+    print("System halted.\n");
+    vga_flush();
+}
+
+void irq_dispatch(uint32_t irq) {
+    if (irq == 7 || irq == 15) {
+        uint8_t isr;
+        outb(irq == 7 ? PIC1_COMMAND : PIC2_COMMAND, 0x0B);
+        isr = inb(irq == 7 ? PIC1_COMMAND : PIC2_COMMAND);
+        if (!(isr & 0x80)) {
+            if (irq == 15) outb(PIC1_COMMAND, PIC_EOI);
+            return;
+        }
+    }
+    if (irq_handlers[irq]) irq_handlers[irq]();
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+void interrupts_init(void) {
+    descriptor_ptr_t gdt_ptr = { sizeof(gdt) - 1, (uint32_t)gdt };
+    gdt_flush(&gdt_ptr);
+
+    for (int i = 0; i < EXC_VECTORS; i++) idt_set_gate(i, exc_stub_table[i]);
+    for (int i = 0; i < 16; i++) idt_set_gate(IRQ_BASE + i, irq_stub_table[i]);
+    descriptor_ptr_t idt_ptr = { sizeof(idt) - 1, (uint32_t)idt };
+    __asm__ volatile ("lidt %0" : : "m"(idt_ptr));
+
+    pic_remap();
+}
+
+void interrupts_enable(void) {
+    __asm__ volatile ("sti");
+}
+
+void irq_register(int irq, irq_handler_t handler) {
+    if (irq < 0 || irq >= 16) return;
+    irq_handlers[irq] = handler;
+    irq_mask &= ~(1 << irq);
+    pic_write_mask();
+}
+
+uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+void irq_restore(uint32_t flags) {
+    if (flags & 0x200) __asm__ volatile ("sti" : : : "memory");
+}
@@ -20,10 +20,53 @@
 #include "vga.h"
 #include "shell.h"
 #include "ramdisk.h"
+#include "timer.h"
+#include "interrupts.h"
+#include "serial.h"
+#include "bench.h"
+#include "io.h"
+#include "string.h"
 
-void kernel_main() {
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+#define MULTIBOOT_INFO_CMDLINE    0x00000004
+#define QEMU_EXIT_PORT            0xF4
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+} multiboot_info_t;
+
+static int cmdline_has(const char *cmdline, const char *word) {
+    size_t len = kstrlen(word);
+    while (*cmdline) {
+        while (*cmdline == ' ') cmdline++;
+        const char *start = cmdline;
+        while (*cmdline && *cmdline != ' ') cmdline++;
+        if ((size_t)(cmdline - start) == len && kstrncmp(start, word, len) == 0) return 1;
+    }
+    return 0;
+}
+
+void kernel_main(uint32_t magic, const multiboot_info_t *info) {
+    int bench_mode = magic == MULTIBOOT_BOOTLOADER_MAGIC &&
+                     (info->flags & MULTIBOOT_INFO_CMDLINE) &&
+                     cmdline_has((const char *)info->cmdline, "bench");
+
+    timer_init();
+    interrupts_init();
+    serial_init();
+    interrupts_enable();
     clear_screen();
     ramdisk_init();
+
+    if (bench_mode) {
+        int status = bench_boot(timer_boot_tsc());
+        outb(QEMU_EXIT_PORT, status == 0 ? 0 : 1);
+    }
+
     shell_run();
 
     while (1)
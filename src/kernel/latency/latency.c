@@ -0,0 +1,131 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "latency.h"
+#include "timer.h"
+#include "kprintf.h"
+#include "div64.h"
+#include "string.h"
+#include "vga.h"
+
+#define LATENCY_BUCKETS 24
+#define LATENCY_RECENT 256
+
+/*
+ * Keystroke-to-screen latency. The keyboard stamps each key with the TSC
+ * value taken when its scancode or serial byte was read, and the next vga
+ * flush that actually reaches video memory closes the sample. Keys that
+ * draw nothing before the next key arrives are not counted.
+ */
+static uint64_t pending_tsc = 0;
+static uint32_t buckets[LATENCY_BUCKETS];
+static uint32_t recent[LATENCY_RECENT];
+static uint32_t samples = 0;
+static uint32_t dropped = 0;
+static uint32_t worst_us = 0;
+
+void latency_key_read(uint64_t tsc) {
+    if (pending_tsc) dropped++;
+    pending_tsc = tsc;
+}
+
+void latency_glyph_drawn(void) {
+    if (!pending_tsc) return;
+    uint64_t us64 = timer_cycles_to_us(timer_read_tsc() - pending_tsc);
+    uint32_t us = us64 > 0xFFFFFFFFULL ? 0xFFFFFFFFU : (uint32_t)us64;
+    pending_tsc = 0;
+
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && (1U << bucket) <= us) bucket++;
+    buckets[bucket]++;
+    recent[samples % LATENCY_RECENT] = us;
+    samples++;
+    if (us > worst_us) worst_us = us;
+}
+
+static void latency_reset(void) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) buckets[i] = 0;
+    pending_tsc = 0;
+    samples = 0;
+    dropped = 0;
+    worst_us = 0;
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, uint32_t pct) {
+    uint32_t index = (count * pct + 99) / 100;
+    if (index > 0) index--;
+    return sorted[index];
+}
+
+int latency_command(const char *args) {
+    static uint32_t sorted[LATENCY_RECENT];
+
+    if (args && kstrcmp(args, "reset") == 0) {
+        latency_reset();
+        kprintf("Latency samples cleared\n");
+        return 0;
+    }
+    if (!timer_has_tsc()) {
+        vga_error_begin();
+        kprintf("lat needs a CPU with RDTSC\n");
+        vga_error_end();
+        return -1;
+    }
+    if (samples == 0) {
+        kprintf("No keystrokes recorded yet\n");
+        return 0;
+    }
+
+    uint32_t count = samples < LATENCY_RECENT ? samples : LATENCY_RECENT;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t value = recent[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+
+    kprintf("keystrokes: %u (%u without output)\n", samples, dropped);
+    kprintf("last %u:    p50 %u us  p90 %u us  p99 %u us  max %u us\n", count,
+            percentile(sorted, count, 50), percentile(sorted, count, 90),
+            percentile(sorted, count, 99), sorted[count - 1]);
+    kprintf("worst ever: %u us\n\n", worst_us);
+
+    uint32_t peak = 0;
+    int first = LATENCY_BUCKETS, last = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (!buckets[i]) continue;
+        if (buckets[i] > peak) peak = buckets[i];
+        if (i < first) first = i;
+        last = i;
+    }
+    for (int i = first; i <= last; i++) {
+        char bar[41];
+        int len = (int)udiv64_32((uint64_t)buckets[i] * 40, peak, NULL);
+        if (buckets[i] && len == 0) len = 1;
+        for (int j = 0; j < len; j++) bar[j] = '#';
+        bar[len] = '\0';
+        if (i == LATENCY_BUCKETS - 1) kprintf("   >=%7u us |%-40s %u\n", 1U << (i - 1), bar, buckets[i]);
+        else kprintf("    <%7u us |%-40s %u\n", 1U << i, bar, buckets[i]);
+    }
+    return 0;
+}
@@ -74,6 +74,16 @@ ramdisk_inode_t* ramdisk_iget(uint32_t inode_no) {
     return &inodes[inode_no];
 }
 
+ramdisk_inode_t* ramdisk_lookup(uint32_t parent_dir_inode_no, const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; i < 32; i++) {
+        if (inodes[i].type != RAMDISK_INODE_TYPE_UNUSED && inodes[i].parent_inode_no == parent_dir_inode_no) {
+            if (strcmp(inodes[i].name, name) == 0) return &inodes[i];
+        }
+    }
+    return NULL;
+}
+
 int ramdisk_create_file(uint32_t parent_dir_inode_no, const char *filename) {
     if (!filename) return -1;
     if (kstrlen(filename) >= RAMDISK_FILENAME_MAX) return -1;
@@ -177,6 +187,16 @@ int ramdisk_writefile(ramdisk_inode_t *file, uint32_t offset, uint32_t size, con
     return size;
 }
 
+int ramdisk_truncate(ramdisk_inode_t *file, uint32_t size) {
+    if (!file) return -1;
+    if (file->type != RAMDISK_INODE_TYPE_FILE) return -1;
+    if (size > file->size) return -1;
+
+    for (uint32_t i = size; i < file->size; i++) file->data[i] = 0;
+    file->size = size;
+    return 0;
+}
+
 void ramdisk_readdir(ramdisk_inode_t *dir, ramdisk_readdir_callback cb) {
     if (!dir || dir->type != RAMDISK_INODE_TYPE_DIR || !cb) return;
     for (int i = 0; i < 32; i++) {
@@ -44,6 +44,8 @@ void ramdisk_init();
 
 ramdisk_inode_t* ramdisk_iget(uint32_t inode_no);
 
+ramdisk_inode_t* ramdisk_lookup(uint32_t parent_dir_inode_no, const char *name);
+
 typedef void (*ramdisk_readdir_callback)(const char *name, uint32_t inode_no);
 void ramdisk_readdir(ramdisk_inode_t *dir, ramdisk_readdir_callback cb);
 
@@ -57,6 +59,8 @@ int ramdisk_readfile(ramdisk_inode_t *file, uint32_t offset, uint32_t size, char
 
 int ramdisk_writefile(ramdisk_inode_t *file, uint32_t offset, uint32_t len, const char *buffer);
 
+int ramdisk_truncate(ramdisk_inode_t *file, uint32_t size);
+
 int ramdisk_get_path(uint32_t inode_no, char *buffer, size_t buffer_size);
 
 #endif
\ No newline at end of file
@@ -24,36 +24,141 @@
 #include "string.h"
 #include "banner.h"
 #include "rtc.h"
+#include "bench.h"
+#include "latency.h"
+#include "timer.h"
+#include "div64.h"
+#include "kprintf.h"
 #include <stddef.h>
 #include <stdint.h>
 
 #define INPUT_BUF_SIZE 256
-#define HISTORY_SIZE 32
+#define HISTORY_DEPTH 128
+#define HISTORY_POOL_SIZE 8192
+#define SEARCH_QUERY_MAX 64
+#define SCRIPT_DEPTH_MAX 4
+#define PIPE_BUF_SIZE 1024
+#define TRIE_MAX_NODES 128
+#define SHELL_CONSOLES 4
 
 static int prompt_start_vga_pos;
-static char history[HISTORY_SIZE][INPUT_BUF_SIZE];
-static int history_count = 0;
-static int history_pos = 0;
+
+typedef struct {
+    char buf[INPUT_BUF_SIZE];
+    int len;
+    int cursor;
+    int shown;
+} line_editor_t;
+
+static line_editor_t line;
+
+typedef struct {
+    char c;
+    uint8_t terminal;
+    int16_t child;
+    int16_t sibling;
+} trie_node_t;
+
+static trie_node_t command_trie[TRIE_MAX_NODES];
+static int command_trie_nodes = 0;
+
+static const char *complete_prefix;
+static size_t complete_prefix_len;
+static char complete_common[RAMDISK_FILENAME_MAX];
+static int complete_matches;
+static int complete_listing;
+
+/*
+ * History is a ring of HISTORY_DEPTH entries whose text lives back to back
+ * in a shared byte pool. Entries and pool offsets are numbered with
+ * free-running counters, so recording a command only copies its bytes and
+ * evicts whatever old entries it overwrites.
+ */
+static char history_pool[HISTORY_POOL_SIZE];
+static uint32_t history_offset[HISTORY_DEPTH];
+static uint16_t history_length[HISTORY_DEPTH];
+static uint32_t history_first = 0;
+static uint32_t history_next = 0;
+static uint32_t history_pool_head = 0;
 static int history_view_pos = -1;
+
+typedef struct {
+    uint32_t seq;
+    int pos;
+} history_match_t;
+
+static char search_query[SEARCH_QUERY_MAX];
+static history_match_t search_matches[SEARCH_QUERY_MAX];
+static int search_len;
+
 static uint32_t current_dir_inode_no = 0;
 
 static uint8_t default_text_fg_color = COLOR_WHITE;
 static uint8_t default_text_bg_color = COLOR_BLACK;
 
-static void print_uint(uint32_t num) {
-    char buf[12];
-    int i = 0;
-    if (num == 0) {
-        putchar('0');
-        return;
-    }
-    while (num > 0) {
-        buf[i++] = (num % 10) + '0';
-        num /= 10;
-    }
-    for (int j = i - 1; j >= 0; j--) {
-        putchar(buf[j]);
+/* Everything a virtual console keeps of its own; history is shared. */
+typedef struct {
+    int started;
+    line_editor_t line;
+    int prompt_start_vga_pos;
+    int history_view_pos;
+    uint32_t current_dir_inode_no;
+    uint8_t fg;
+    uint8_t bg;
+} shell_console_t;
+
+static shell_console_t shell_consoles[SHELL_CONSOLES];
+static int active_shell_console = 0;
+
+static int command_status = 0;
+static int script_depth = 0;
+
+typedef struct {
+    char *buf;
+    int len;
+    int size;
+} capture_sink_t;
+
+typedef struct {
+    ramdisk_inode_t *file;
+    uint32_t offset;
+    int overflow;
+} file_sink_t;
+
+void shell_error_begin(void) {
+    vga_error_begin();
+}
+
+void shell_error_end(void) {
+    vga_error_end();
+    command_status = -1;
+}
+
+static void print_error(const char *msg) {
+    shell_error_begin();
+    print(msg);
+    shell_error_end();
+}
+
+static void capture_write(void *ctx, const char *buf, int len) {
+    capture_sink_t *capture = ctx;
+    for (int i = 0; i < len && capture->len < capture->size - 1; i++) {
+        capture->buf[capture->len++] = buf[i];
     }
+    capture->buf[capture->len] = '\0';
+}
+
+static void file_write(void *ctx, const char *buf, int len) {
+    file_sink_t *sink = ctx;
+    int written = ramdisk_writefile(sink->file, sink->offset, (uint32_t)len, buf);
+    if (written > 0) sink->offset += written;
+    if (written != len) sink->overflow = 1;
+}
+
+static void discard_write(void *ctx, const char *buf, int len) {
+    (void)ctx;
+    (void)buf;
+    (void)len;
 }
 
 static void print_prompt() {
@@ -74,74 +179,239 @@ static void print_prompt() {
     set_text_color(default_text_fg_color, default_text_bg_color);
 }
 
+static int history_count(void) {
+    return (int)(history_next - history_first);
+}
+
+static char history_char(uint32_t seq, int i) {
+    uint32_t off = history_offset[seq % HISTORY_DEPTH] + (uint32_t)i;
+    return history_pool[off % HISTORY_POOL_SIZE];
+}
+
 static void add_history(const char *cmd) {
     if (cmd[0] == '\0') return;
-    if (history_count < HISTORY_SIZE) {
-        kstrncpy(history[history_count], cmd, INPUT_BUF_SIZE - 1);
-        history[history_count][INPUT_BUF_SIZE - 1] = '\0';
-        history_count++;
-    } else {
-        for (int i = 1; i < HISTORY_SIZE; i++) {
-            kstrcpy(history[i - 1], history[i]);
-        }
-        kstrncpy(history[HISTORY_SIZE - 1], cmd, INPUT_BUF_SIZE - 1);
-        history[HISTORY_SIZE - 1][INPUT_BUF_SIZE - 1] = '\0';
+    size_t len = kstrlen(cmd);
+    if (len > HISTORY_POOL_SIZE) len = HISTORY_POOL_SIZE;
+    while (history_count() > 0 &&
+           (history_count() == HISTORY_DEPTH ||
+            history_pool_head + len - history_offset[history_first % HISTORY_DEPTH] > HISTORY_POOL_SIZE)) {
+        history_first++;
+    }
+    uint32_t slot = history_next % HISTORY_DEPTH;
+    history_offset[slot] = history_pool_head;
+    history_length[slot] = (uint16_t)len;
+    for (size_t i = 0; i < len; i++) {
+        history_pool[(history_pool_head + i) % HISTORY_POOL_SIZE] = cmd[i];
     }
-    history_pos = history_count;
+    history_pool_head += len;
+    history_next++;
     history_view_pos = -1;
 }
 
-static void clear_input_line(int len) {
-    vga_clear_chars(prompt_start_vga_pos, len);
-    set_cursor_pos(prompt_start_vga_pos);
+static void copy_history(uint32_t seq, char *buf, int size) {
+    int len = history_length[seq % HISTORY_DEPTH];
+    if (len > size - 1) len = size - 1;
+    for (int i = 0; i < len; i++) buf[i] = history_char(seq, i);
+    buf[len] = '\0';
 }
 
-static void load_history_line(char *input, int *idx, int *cursor_index, int pos) {
-    if (pos < 0 || pos >= history_count) return;
-    clear_input_line(get_screen_width());
-    kstrncpy(input, history[pos], INPUT_BUF_SIZE - 1);
-    input[INPUT_BUF_SIZE - 1] = '\0';
-    *idx = kstrlen(input);
-    *cursor_index = *idx;
-    set_cursor_pos(prompt_start_vga_pos);
-    print(input);
+static int history_find(uint32_t seq, const char *query, int query_len, int from) {
+    int len = history_length[seq % HISTORY_DEPTH];
+    for (int pos = from; pos + query_len <= len; pos++) {
+        int i = 0;
+        while (i < query_len && history_char(seq, pos + i) == query[i]) i++;
+        if (i == query_len) return pos;
+    }
+    return -1;
 }
 
-static ramdisk_inode_t *ramdisk_find_inode_by_name(ramdisk_inode_t *dir, const char *name) {
-    ramdisk_inode_t *found = NULL;
-    void callback(const char *entry_name, uint32_t inode_no) {
-        if (kstrcmp(entry_name, name) == 0) {
-            found = ramdisk_iget(inode_no);
+static int search_older(uint32_t seq, int from, history_match_t *match) {
+    while (seq >= history_first && seq < history_next) {
+        int pos = history_find(seq, search_query, search_len, from);
+        if (pos >= 0) {
+            match->seq = seq;
+            match->pos = pos;
+            return 1;
+        }
+        if (seq == history_first) break;
+        seq--;
+        from = 0;
+    }
+    return 0;
+}
+
+/*
+ * The line editor only repaints from the edit point onward. `shown` is how
+ * many cells the previous paint used, so shrinking the line blanks just the
+ * leftover tail. Long input wraps through the linear VGA position; if the
+ * paint scrolls the screen, the prompt origin moves up with it.
+ */
+static void editor_paint(const char *text, int from, int len) {
+    set_cursor_pos(prompt_start_vga_pos + from);
+    print(text + from);
+    int expected = prompt_start_vga_pos + len;
+    int actual = get_cursor();
+    if (actual < expected) prompt_start_vga_pos -= expected - actual;
+    if (line.shown > len) vga_clear_chars(prompt_start_vga_pos + len, line.shown - len);
+    line.shown = len;
+}
+
+static void editor_sync_cursor(void) {
+    set_cursor_pos(prompt_start_vga_pos + line.cursor);
+}
+
+static void editor_redraw_from(int from) {
+    line.buf[line.len] = '\0';
+    editor_paint(line.buf, from, line.len);
+    editor_sync_cursor();
+}
+
+static void editor_set(const char *text) {
+    kstrncpy(line.buf, text, INPUT_BUF_SIZE - 1);
+    line.buf[INPUT_BUF_SIZE - 1] = '\0';
+    line.len = kstrlen(line.buf);
+    line.cursor = line.len;
+    editor_redraw_from(0);
+}
+
+static void editor_reset(void) {
+    line.len = 0;
+    line.cursor = 0;
+    line.shown = 0;
+    line.buf[0] = '\0';
+}
+
+static void editor_insert(char c) {
+    if (line.len >= INPUT_BUF_SIZE - 1) return;
+    for (int i = line.len; i > line.cursor; i--) line.buf[i] = line.buf[i - 1];
+    line.buf[line.cursor] = c;
+    line.len++;
+    line.cursor++;
+    editor_redraw_from(line.cursor - 1);
+}
+
+static void editor_insert_text(const char *text, int count) {
+    if (line.len + count > INPUT_BUF_SIZE - 1) count = INPUT_BUF_SIZE - 1 - line.len;
+    if (count <= 0) return;
+    for (int i = line.len - 1; i >= line.cursor; i--) line.buf[i + count] = line.buf[i];
+    for (int i = 0; i < count; i++) line.buf[line.cursor + i] = text[i];
+    line.len += count;
+    line.cursor += count;
+    editor_redraw_from(line.cursor - count);
+}
+
+static void editor_delete(int from, int count) {
+    if (count <= 0) return;
+    for (int i = from; i + count < line.len; i++) line.buf[i] = line.buf[i + count];
+    line.len -= count;
+    line.cursor = from;
+    editor_redraw_from(from);
+}
+
+static int editor_word_left(void) {
+    int i = line.cursor;
+    while (i > 0 && line.buf[i - 1] == ' ') i--;
+    while (i > 0 && line.buf[i - 1] != ' ') i--;
+    return i;
+}
+
+static int editor_word_right(void) {
+    int i = line.cursor;
+    while (i < line.len && line.buf[i] == ' ') i++;
+    while (i < line.len && line.buf[i] != ' ') i++;
+    return i;
+}
+
+static void load_history_line(int pos) {
+    if (pos < 0 || pos >= history_count()) return;
+    char entry[INPUT_BUF_SIZE];
+    copy_history(history_first + (uint32_t)pos, entry, INPUT_BUF_SIZE);
+    editor_set(entry);
+}
+
+static void show_search(const char *match, int failed) {
+    char display[INPUT_BUF_SIZE + SEARCH_QUERY_MAX + 32];
+    kstrcpy(display, failed ? "(failed reverse-i-search)'" : "(reverse-i-search)'");
+    size_t len = kstrlen(display);
+    kstrcpy(display + len, search_query);
+    len += search_len;
+    kstrcpy(display + len, "': ");
+    len += 3;
+    kstrcpy(display + len, match);
+    len += kstrlen(match);
+    editor_paint(display, 0, (int)len);
+}
+
+/*
+ * Ctrl-R incremental search. search_matches[n] remembers where the query's
+ * first n characters matched (pos -1 once it stopped matching), so typing
+ * only scans from the current match towards older entries and backspace
+ * pops back to the previous match without searching again.
+ */
+static int reverse_search(void) {
+    char match[INPUT_BUF_SIZE];
+    history_match_t current;
+    search_len = 0;
+    search_query[0] = '\0';
+    current.seq = history_next - 1;
+    current.pos = history_count() > 0 ? 0 : -1;
+    search_matches[0] = current;
+    match[0] = '\0';
+    show_search(match, current.pos < 0);
+    while (1) {
+        int c = keyboard_getchar();
+        if (c == KEY_NULL) continue;
+        if (c == KEY_CTRL_R) {
+            history_match_t older;
+            if (search_len == 0 || current.pos < 0) continue;
+            if (current.seq > history_first && search_older(current.seq - 1, 0, &older)) {
+                current = older;
+                search_matches[search_len] = current;
+                copy_history(current.seq, match, INPUT_BUF_SIZE);
+            } else {
+                current.pos = -1;
+            }
+        } else if (c == KEY_BACKSPACE) {
+            if (search_len == 0) continue;
+            search_query[--search_len] = '\0';
+            current = search_matches[search_len];
+            if (current.pos >= 0 && search_len > 0) copy_history(current.seq, match, INPUT_BUF_SIZE);
+            if (search_len == 0) match[0] = '\0';
+        } else if (c >= 32 && c <= 126) {
+            if (search_len >= SEARCH_QUERY_MAX - 1) continue;
+            search_query[search_len++] = (char)c;
+            search_query[search_len] = '\0';
+            if (current.pos >= 0 && search_older(current.seq, current.pos, &current)) {
+                copy_history(current.seq, match, INPUT_BUF_SIZE);
+            } else {
+                current.pos = -1;
+            }
+            search_matches[search_len] = current;
+        } else if (c == KEY_ESCAPE || c == KEY_CTRL_G) {
+            editor_set("");
+            return KEY_NULL;
+        } else {
+            history_view_pos = -1;
+            editor_set(match);
+            return c;
         }
+        show_search(match, current.pos < 0);
     }
-    ramdisk_readdir(dir, callback);
-    return found;
+}
+
+static ramdisk_inode_t *ramdisk_find_inode_by_name(ramdisk_inode_t *dir, const char *name) {
+    return ramdisk_lookup(dir->inode_no, name);
 }
 
 static void print_name_callback(const char *name, uint32_t inode) {
     if (kstrcmp(name, "/") == 0) return;
     ramdisk_inode_t *node = ramdisk_iget(inode);
-    if (node && node->type == RAMDISK_INODE_TYPE_DIR) {
-        print("[");
-        print(name);
-        print("]\n");
-    } else {
-        print(name);
-        print("\n");
-    }
+    kprintf(node && node->type == RAMDISK_INODE_TYPE_DIR ? "[%s]\n" : "%s\n", name);
 }
 
 static void handle_rtc_command() {
     rtc_time_t current_time;
     read_rtc_time(&current_time);
-    if (current_time.month < 10) putchar('0');
-    print_uint(current_time.month);
-    putchar('/');
-    if (current_time.day < 10) putchar('0');
-    print_uint(current_time.day);
-    putchar('/');
-    print_uint(current_time.year);
-    print(" ");
     uint8_t display_hour = current_time.hour;
     const char* ampm = "AM";
     if (display_hour >= 12) {
@@ -152,148 +422,21 @@ static void handle_rtc_command() {
     } else if (display_hour == 0) {
         display_hour = 12;
     }
-    if (display_hour < 10) putchar('0');
-    print_uint(display_hour);
-    putchar(':');
-    if (current_time.minute < 10) putchar('0');
-    print_uint(current_time.minute);
-    putchar(':');
-    if (current_time.second < 10) putchar('0');
-    print_uint(current_time.second);
-    putchar(' ');
-    print(ampm);
-    print("\n");
-}
-
-static uint8_t ansi_to_vga_color(int ansi_color) {
-    switch (ansi_color) {
-        case 30: return COLOR_BLACK;
-        case 31: return COLOR_DARKRED;
-        case 32: return COLOR_DARKGREEN;
-        case 33: return COLOR_BROWN;
-        case 34: return COLOR_DARKBLUE;
-        case 35: return COLOR_MAGENTA;
-        case 36: return COLOR_DARKCYAN;
-        case 37: return COLOR_LIGHT_GREY;
-        case 90: return COLOR_DARK_GREY;
-        case 91: return COLOR_RED;
-        case 92: return COLOR_GREEN;
-        case 93: return COLOR_YELLOW; 
-        case 94: return COLOR_BLUE;
-        case 95: return COLOR_MAGENTA;
-        case 96: return COLOR_CYAN;
-        case 97: return COLOR_WHITE;
-        default: return COLOR_LIGHT_GREY;
-    }
-}
-
-static uint8_t ansi_bg_to_vga_color(int ansi_color) {
-    switch (ansi_color) {
-        case 40: return COLOR_BLACK;
-        case 41: return COLOR_DARKRED;
-        case 42: return COLOR_DARKGREEN;
-        case 43: return COLOR_BROWN;
-        case 44: return COLOR_DARKBLUE;
-        case 45: return COLOR_MAGENTA;
-        case 46: return COLOR_DARKCYAN;
-        case 47: return COLOR_LIGHT_GREY;
-        case 100: return COLOR_DARK_GREY;
-        case 101: return COLOR_RED;
-        case 102: return COLOR_GREEN;
-        case 103: return COLOR_YELLOW; 
-        case 104: return COLOR_BLUE;
-        case 105: return COLOR_MAGENTA;
-        case 106: return COLOR_CYAN;
-        case 107: return COLOR_WHITE;
-        default: return COLOR_BLACK;
-    }
-}
-
-static void print_ansi(const char* ansi_str) {
-    uint8_t current_fg = COLOR_WHITE;
-    uint8_t current_bg = COLOR_BLACK;
-    set_text_color(current_fg, current_bg);
-    while (*ansi_str) {
-        if (*ansi_str == '\033' && *(ansi_str + 1) == '[') {
-            ansi_str += 2;
-            int code_val = 0;
-            int attribute_count = 0;
-            int attributes[5];
-            for (int i = 0; i < 5; i++) {
-                attributes[i] = 0;
-            }
-            while (*ansi_str >= '0' && *ansi_str <= '9') {
-                code_val = code_val * 10 + (*ansi_str - '0');
-                ansi_str++;
-            }
-            if (*ansi_str == ';') {
-                attributes[attribute_count++] = code_val;
-                code_val = 0;
-                ansi_str++;
-                while (*ansi_str != 'm' && *ansi_str != '\0') {
-                    if (*ansi_str >= '0' && *ansi_str <= '9') {
-                        code_val = code_val * 10 + (*ansi_str - '0');
-                    } else if (*ansi_str == ';') {
-                        if (attribute_count < 5) attributes[attribute_count++] = code_val;
-                        code_val = 0;
-                    }
-                    ansi_str++;
-                }
-                if (attribute_count < 5) attributes[attribute_count++] = code_val;
-            } else if (*ansi_str == 'm') {
-                if (attribute_count < 5) attributes[attribute_count++] = code_val;
-            }
-            if (*ansi_str == 'm') {
-                for (int i = 0; i < attribute_count; i++) {
-                    int attr = attributes[i];
-                    if (attr == 0) {
-                        current_fg = COLOR_LIGHT_GREY;
-                        current_bg = COLOR_BLACK;
-                    } else if (attr == 1) {
-                    } else if (attr == 5) {
-                    } else if (attr == 7) {
-                        uint8_t temp = current_fg;
-                        current_fg = current_bg;
-                        current_bg = temp;
-                    } else if (attr == 8) {
-                        current_fg = current_bg;
-                    } else if (attr >= 30 && attr <= 37) {
-                        current_fg = ansi_to_vga_color(attr);
-                    } else if (attr >= 40 && attr <= 47) {
-                        current_bg = ansi_bg_to_vga_color(attr);
-                    } else if (attr >= 90 && attr <= 97) {
-                        current_fg = ansi_to_vga_color(attr);
-                    } else if (attr >= 100 && attr <= 107) {
-                        current_bg = ansi_bg_to_vga_color(attr);
-                    } else if (attr == 25) {
-                    } else if (attr == 27) {
-                    } else if (attr == 28) {
-                    }
-                }
-                set_text_color(current_fg, current_bg);
-                ansi_str++;
-            } else if (*ansi_str == 's') {
-                ansi_str++;
-            } else if (*ansi_str == 'u') {
-                ansi_str++;
-            } else {
-                while (*ansi_str != 'm' && *ansi_str != '\0') {
-                    ansi_str++;
-                }
-                if (*ansi_str == 'm') ansi_str++;
-            }
-        } else {
-            putchar(*ansi_str);
-            ansi_str++;
-        }
-    }
+    kprintf("%02u/%02u/%u %02u:%02u:%02u %s\n",
+            current_time.month, current_time.day, current_time.year,
+            display_hour, current_time.minute, current_time.second, ampm);
 }
 
 static void ban(const char* args) {
     (void)args;
+    int rows = (_binary_banner_bin_end - _binary_banner_bin_start) / BANNER_WIDTH;
+    if (vga_has_sink()) {
+        vga_blit_rows(0, _binary_banner_bin_start, BANNER_WIDTH, rows);
+        return;
+    }
     clear_screen();
-    set_cursor_pos(0);
-    print_ansi((const char*)_binary_src_banner_banner_txt_start);
+    vga_blit_rows(0, _binary_banner_bin_start, BANNER_WIDTH, rows);
+    set_cursor_pos(rows * get_screen_width());
     set_text_color(default_text_fg_color, default_text_bg_color);
     int key;
     print("\nPress 'e' to exit to shell");
@@ -315,7 +458,7 @@ typedef struct {
 
 static void hlp(const char* args) {
     (void)args;
-    print("Commands: hlp, cls, say, ver, hi, ls, see, add, rem, mkd, cd, sum, rtc, clr, ban");
+    print("Commands: hlp, cls, say, ver, hi, ls, see, add, rem, mkd, cd, sum, rtc, clr, ban, run, time, bench, mode, lat, powmod");
 }
 
 static void ver(const char* args) {
@@ -339,16 +482,18 @@ static void say(const char* args) {
 }
 
 static void sum(const char* args) {
-    calc_command(args ? args : "");
+    if (calc_command(args ? args : "") != 0) command_status = -1;
+}
+
+static void powmod(const char* args) {
+    if (calc_powmod_command(args ? args : "") != 0) command_status = -1;
 }
 
 static void ls(const char* args) {
     (void)args;
     ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
     if (!dir) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to get directory inode\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to get directory inode\n");
         return;
     }
     ramdisk_readdir(dir, print_name_callback);
@@ -356,39 +501,29 @@ static void ls(const char* args) {
 
 static void see(const char* args) {
     if (!args) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Usage: see <filename>\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Usage: see <filename>\n");
         return;
     }
     const char *filename = args;
     ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
     if (!dir) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to get current directory\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to get current directory\n");
         return;
     }
     ramdisk_inode_t *file = ramdisk_find_inode_by_name(dir, filename);
     if (!file) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("File not found\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("File not found\n");
         return;
     }
     if (file->type == RAMDISK_INODE_TYPE_DIR) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Cannot see directory\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Cannot see directory\n");
         return;
     }
 
     char buf[2048];
     int read = ramdisk_readfile(file, 0, sizeof(buf) - 1, buf);
     if (read < 0) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Error reading file\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Error reading file\n");
         return;
     }
     buf[read] = 0;
@@ -399,9 +534,7 @@ static void see(const char* args) {
 
 static void add(const char* args) {
     if (!args) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Usage: add <filename> <text_to_add>\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Usage: add <filename> <text_to_add>\n");
         return;
     }
 
@@ -420,9 +553,7 @@ static void add(const char* args) {
     if (space_pos) {
         size_t filename_len = space_pos - args;
         if (filename_len >= RAMDISK_FILENAME_MAX) {
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Error: Filename too long (max 27 characters).\n");
-            set_text_color(default_text_fg_color, default_text_bg_color);
+            print_error("Error: Filename too long (max 27 characters).\n");
             return;
         }
         for (size_t i = 0; i < filename_len; ++i) {
@@ -438,41 +569,33 @@ static void add(const char* args) {
             text_to_add = NULL;
         }
     } else {
-        set_text_color(COLOR_RED, COLOR_BLACK);
+        shell_error_begin();
         print("Usage: add <filename> <text_to_add>\n");
         print("Error: No text to add provided.\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        shell_error_end();
         return;
     }
 
     ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
     if (!dir) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to get current directory\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to get current directory\n");
         return;
     }
 
     ramdisk_inode_t *file = ramdisk_find_inode_by_name(dir, filename);
     if (!file) {
         if (ramdisk_create_file(current_dir_inode_no, filename) != 0) {
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Failed to create file\n");
-            set_text_color(default_text_fg_color, default_text_bg_color);
+            print_error("Failed to create file\n");
             return;
         }
         file = ramdisk_find_inode_by_name(dir, filename);
         if (!file) {
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Error: Could not retrieve newly created file.\n");
-            set_text_color(default_text_fg_color, default_text_bg_color);
+            print_error("Error: Could not retrieve newly created file.\n");
             return;
         }
     }
     if (file->type == RAMDISK_INODE_TYPE_DIR) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Cannot add text to a directory.\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Cannot add text to a directory.\n");
         return;
     }
 
@@ -495,11 +618,10 @@ static void add(const char* args) {
     if (text_to_add) {
         size_t text_len = kstrlen(text_to_add);
         if (content_length + text_len >= RAMDISK_DATA_SIZE_BYTES) {
-            set_text_color(COLOR_RED, COLOR_BLACK);
-            print("Error: Combined text would exceed maximum file size (");
-            print_uint(RAMDISK_DATA_SIZE_BYTES);
-            print(" bytes).\n");
-            set_text_color(default_text_fg_color, default_text_bg_color);
+            shell_error_begin();
+            kprintf("Error: Combined text would exceed maximum file size (%u bytes).\n",
+                    RAMDISK_DATA_SIZE_BYTES);
+            shell_error_end();
             return;
         }
         kstrcpy(new_content + content_length, text_to_add);
@@ -514,9 +636,7 @@ static void add(const char* args) {
     }
 
     if (ramdisk_writefile(file, 0, content_length, new_content) < 0) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to write to file\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to write to file\n");
         return;
     }
 
@@ -525,43 +645,33 @@ static void add(const char* args) {
 
 static void rem(const char* args) {
     if (!args) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Usage: rem <filename>\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Usage: rem <filename>\n");
         return;
     }
     int res = ramdisk_remove_file(current_dir_inode_no, args);
     if (res == 0) {
         print("File removed\n");
     } else {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to remove file\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to remove file\n");
     }
 }
 
 static void mkd(const char* args) {
     if (!args) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Usage: mkd <dirname>\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Usage: mkd <dirname>\n");
         return;
     }
     int res = ramdisk_create_dir(current_dir_inode_no, args);
     if (res == 0) {
         print("Directory created\n");
     } else {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to create directory\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to create directory\n");
     }
 }
 
 static void cd(const char* args) {
     if (!args) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Usage: cd <dirname>\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Usage: cd <dirname>\n");
         return;
     }
     const char *dirname = args;
@@ -575,16 +685,12 @@ static void cd(const char* args) {
     }
     ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
     if (!dir) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Failed to get current directory\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Failed to get current directory\n");
         return;
     }
     ramdisk_inode_t *new_dir = ramdisk_find_inode_by_name(dir, dirname);
     if (!new_dir || new_dir->type != RAMDISK_INODE_TYPE_DIR) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Directory not found\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Directory not found\n");
         return;
     }
     current_dir_inode_no = new_dir->inode_no;
@@ -633,9 +739,7 @@ static void clr(const char* arg) {
     else if (kstrcmp(arg, "yellow") == 0) new_fg_color = COLOR_YELLOW;
     else if (kstrcmp(arg, "white") == 0) new_fg_color = COLOR_WHITE;
     else {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print("Invalid color. Use 'clr hlp' for options.\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+        print_error("Invalid color. Use 'clr hlp' for options.\n");
         return;
     }
     default_text_fg_color = new_fg_color;
@@ -645,6 +749,208 @@ static void clr(const char* arg) {
     print("Color set.\n");
 }
 
+int shell_run_script(const char *script, size_t len, int flags, shell_script_result_t *result) {
+    result->ran = 0;
+    result->failed = 0;
+    result->failed_line = 0;
+    if (script_depth >= SCRIPT_DEPTH_MAX) return -1;
+
+    vga_sink_t discard = { discard_write, NULL };
+    vga_sink_t saved_sink = discard;
+    if (flags & SHELL_SCRIPT_QUIET) saved_sink = vga_set_sink(discard);
+    script_depth++;
+
+    char cmd[INPUT_BUF_SIZE];
+    int line_no = 0;
+    size_t pos = 0;
+    while (pos < len && script[pos] != '\0') {
+        size_t start = pos;
+        while (pos < len && script[pos] != '\0' && script[pos] != '\n') pos++;
+        size_t end = pos;
+        if (pos < len && script[pos] == '\n') pos++;
+        line_no++;
+        while (start < end && (script[start] == ' ' || script[start] == '\t')) start++;
+        while (end > start && (script[end - 1] == ' ' || script[end - 1] == '\r')) end--;
+        if (start == end || script[start] == '#') continue;
+        if (end - start >= INPUT_BUF_SIZE) end = start + INPUT_BUF_SIZE - 1;
+        kstrncpy(cmd, script + start, end - start);
+        cmd[end - start] = '\0';
+
+        if (flags & SHELL_SCRIPT_ECHO) {
+            print("> ");
+            print(cmd);
+            print("\n");
+        }
+        result->ran++;
+        if (shell_execute(cmd) != 0) {
+            if (!result->failed) result->failed_line = line_no;
+            result->failed++;
+            if (flags & SHELL_SCRIPT_STOP_ON_ERROR) break;
+        }
+    }
+
+    script_depth--;
+    if (flags & SHELL_SCRIPT_QUIET) vga_set_sink(saved_sink);
+    return result->failed ? -1 : 0;
+}
+
+static void run(const char* args) {
+    int flags = 0;
+    while (args && args[0] == '-') {
+        args++;
+        while (*args && *args != ' ') {
+            if (*args == 'e') flags |= SHELL_SCRIPT_STOP_ON_ERROR;
+            else if (*args == 'q') flags |= SHELL_SCRIPT_QUIET;
+            else {
+                print_error("Usage: run [-e] [-q] <filename>\n");
+                return;
+            }
+            args++;
+        }
+        while (*args == ' ') args++;
+    }
+    if (!args || *args == '\0') {
+        print_error("Usage: run [-e] [-q] <filename>\n");
+        return;
+    }
+    if (script_depth >= SCRIPT_DEPTH_MAX) {
+        print_error("Scripts nested too deeply\n");
+        return;
+    }
+    ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
+    ramdisk_inode_t *file = dir ? ramdisk_find_inode_by_name(dir, args) : NULL;
+    if (!file || file->type != RAMDISK_INODE_TYPE_FILE) {
+        print_error("File not found\n");
+        return;
+    }
+
+    char script[RAMDISK_DATA_SIZE_BYTES];
+    int size = ramdisk_readfile(file, 0, RAMDISK_DATA_SIZE_BYTES, script);
+    if (size < 0) {
+        print_error("Error reading file\n");
+        return;
+    }
+
+    shell_script_result_t result;
+    shell_run_script(script, (size_t)size, flags, &result);
+
+    if (flags & SHELL_SCRIPT_QUIET) {
+        kprintf("%d commands run, %d failed\n", result.ran, result.failed);
+    }
+    if (result.failed) {
+        shell_error_begin();
+        kprintf("%s %d\n", (flags & SHELL_SCRIPT_STOP_ON_ERROR) ? "Script stopped at line" : "First failure at line",
+                result.failed_line);
+        shell_error_end();
+    } else {
+        command_status = 0;
+    }
+}
+
+static uint32_t rtc_seconds_of_day(void) {
+    rtc_time_t now;
+    read_rtc_time(&now);
+    return (uint32_t)now.hour * 3600 + (uint32_t)now.minute * 60 + now.second;
+}
+
+static void time_command(const char* args) {
+    if (!args || *args == '\0') {
+        print_error("Usage: time <command>\n");
+        return;
+    }
+    uint32_t chars_before = vga_get_chars_written();
+    uint32_t rtc_before = timer_has_tsc() ? 0 : rtc_seconds_of_day();
+    uint64_t start = timer_read_tsc();
+    int status = shell_execute(args);
+    uint64_t end = timer_read_tsc();
+    uint32_t chars = vga_get_chars_written() - chars_before;
+
+    if (timer_has_tsc()) {
+        uint32_t frac;
+        uint64_t us = timer_cycles_to_us(end - start);
+        uint64_t ms = udiv64_32(us, 1000, &frac);
+        kprintf("cycles: %llu\ntime:   %llu.%03u ms\n", end - start, ms, frac);
+    } else {
+        uint32_t rtc_after = rtc_seconds_of_day();
+        if (rtc_after < rtc_before) rtc_after += 24 * 3600;
+        kprintf("cycles: unavailable (no TSC)\ntime:   %u s (RTC)\n", rtc_after - rtc_before);
+    }
+    kprintf("chars:  %u\n", chars);
+    command_status = status;
+}
+
+static const char *parse_dimension(const char *s, int *value) {
+    *value = 0;
+    if (*s < '0' || *s > '9') return NULL;
+    while (*s >= '0' && *s <= '9') *value = *value * 10 + (*s++ - '0');
+    return s;
+}
+
+static void mode(const char* args) {
+    int width, height;
+    const char *p = args;
+    if (!args || *args == '\0') {
+        kprintf("Current mode: %dx%d\nUsage: mode <80x25|80x50|90x60>\n",
+                get_screen_width(), get_screen_height());
+        return;
+    }
+    p = parse_dimension(p, &width);
+    if (p && (*p == 'x' || *p == 'X')) p = parse_dimension(p + 1, &height);
+    else p = NULL;
+    if (!p || *p != '\0') {
+        print_error("Usage: mode <80x25|80x50|90x60>\n");
+        return;
+    }
+    if (vga_set_mode(width, height) != 0) {
+        print_error("Unsupported mode\n");
+        return;
+    }
+    for (int i = 0; i < SHELL_CONSOLES; i++) {
+        if (i != active_shell_console) shell_consoles[i].started = 0;
+    }
+}
+
+static void switch_console(int index) {
+    shell_console_t *state = &shell_consoles[active_shell_console];
+    if (index == active_shell_console) return;
+    state->line = line;
+    state->prompt_start_vga_pos = prompt_start_vga_pos;
+    state->history_view_pos = history_view_pos;
+    state->current_dir_inode_no = current_dir_inode_no;
+    state->fg = default_text_fg_color;
+    state->bg = default_text_bg_color;
+
+    if (vga_switch_console(index) != 0) return;
+    active_shell_console = index;
+    state = &shell_consoles[index];
+    if (!state->started) {
+        state->started = 1;
+        current_dir_inode_no = 0;
+        default_text_fg_color = COLOR_WHITE;
+        default_text_bg_color = COLOR_BLACK;
+        history_view_pos = -1;
+        set_text_color(default_text_fg_color, default_text_bg_color);
+        editor_reset();
+        print_prompt();
+        prompt_start_vga_pos = get_cursor();
+        return;
+    }
+    line = state->line;
+    prompt_start_vga_pos = state->prompt_start_vga_pos;
+    history_view_pos = state->history_view_pos;
+    current_dir_inode_no = state->current_dir_inode_no;
+    default_text_fg_color = state->fg;
+    default_text_bg_color = state->bg;
+}
+
+static void bench(const char* args) {
+    if (bench_command(args) != 0) command_status = -1;
+}
+
+static void lat(const char* args) {
+    if (latency_command(args) != 0) command_status = -1;
+}
+
 static shell_command_t commands[] = {
     {"hlp", hlp},
     {"ver", ver},
@@ -652,6 +958,7 @@ static shell_command_t commands[] = {
     {"cls", cls},
     {"say", say},
     {"sum", sum},
+    {"powmod", powmod},
     {"ls", ls},
     {"see", see},
     {"add", add},
@@ -661,11 +968,16 @@ static shell_command_t commands[] = {
     {"rtc", rtc},
     {"clr", clr},
     {"ban", ban},
+    {"run", run},
+    {"time", time_command},
+    {"bench", bench},
+    {"mode", mode},
+    {"lat", lat},
     {NULL, NULL}
 };
 
-void shell_execute(const char* cmd) {
-    if (cmd[0] == '\0') return;
+static int execute_command(const char* cmd) {
+    if (cmd[0] == '\0') return 0;
     char command[INPUT_BUF_SIZE];
     const char *args;
     args = kstrchr(cmd, ' ');
@@ -680,134 +992,388 @@ void shell_execute(const char* cmd) {
         command[INPUT_BUF_SIZE - 1] = '\0';
         args = NULL;
     }
-    int found = 0;
     for (int i = 0; commands[i].name != NULL; i++) {
         if (kstrcmp(command, commands[i].name) == 0) {
+            command_status = 0;
             commands[i].func(args);
-            found = 1;
-            break;
+            return command_status;
         }
     }
-    if (!found) {
-        set_text_color(COLOR_RED, COLOR_BLACK);
-        print(cmd);
-        print(": command not found\n");
-        set_text_color(default_text_fg_color, default_text_bg_color);
+    shell_error_begin();
+    print(cmd);
+    print(": command not found\n");
+    shell_error_end();
+    return -1;
+}
+
+static int copy_trimmed(char *dest, const char *src, size_t len, size_t size) {
+    while (len > 0 && *src == ' ') {
+        src++;
+        len--;
+    }
+    while (len > 0 && (src[len - 1] == ' ' || src[len - 1] == '\n')) len--;
+    if (len >= size) return -1;
+    kstrncpy(dest, src, len);
+    dest[len] = '\0';
+    return (int)len;
+}
+
+static ramdisk_inode_t *open_redirect(const char *filename, int append, uint32_t *offset) {
+    ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
+    if (!dir) return NULL;
+    ramdisk_inode_t *file = ramdisk_find_inode_by_name(dir, filename);
+    if (!file) {
+        if (ramdisk_create_file(current_dir_inode_no, filename) != 0) return NULL;
+        file = ramdisk_find_inode_by_name(dir, filename);
+    }
+    if (!file || file->type != RAMDISK_INODE_TYPE_FILE) return NULL;
+    if (!append) ramdisk_truncate(file, 0);
+    *offset = file->size;
+    return file;
+}
+
+/*
+ * Runs `a | b | c > file`. Each stage's output goes to a sink instead of the
+ * screen: the next stage receives it appended to its arguments, and the last
+ * stage writes straight into the ramdisk file when redirected.
+ */
+static int execute_pipeline(const char *cmd) {
+    char stage[INPUT_BUF_SIZE + PIPE_BUF_SIZE];
+    char pipe_bufs[2][PIPE_BUF_SIZE];
+    char *piped = NULL;
+    int failed = 0;
+    const char *p = cmd;
+
+    while (1) {
+        const char *bar = kstrchr(p, '|');
+        size_t stage_len = bar ? (size_t)(bar - p) : kstrlen(p);
+        const char *redirect = kstrchr(p, '>');
+        if (redirect && bar && redirect < bar) {
+            print_error("Redirection must come last in a pipeline\n");
+            return -1;
+        }
+        if (!bar && redirect) stage_len = (size_t)(redirect - p);
+
+        int len = copy_trimmed(stage, p, stage_len, INPUT_BUF_SIZE);
+        if (len <= 0) {
+            print_error(len < 0 ? "Command too long\n" : "Invalid pipeline\n");
+            return -1;
+        }
+        if (piped && piped[0]) {
+            stage[len++] = ' ';
+            kstrcpy(stage + len, piped);
+        }
+
+        vga_sink_t saved;
+        if (bar) {
+            char *out = (piped == pipe_bufs[0]) ? pipe_bufs[1] : pipe_bufs[0];
+            capture_sink_t capture = { out, 0, PIPE_BUF_SIZE };
+            vga_sink_t sink = { capture_write, &capture };
+            out[0] = '\0';
+            saved = vga_set_sink(sink);
+            if (execute_command(stage) != 0) failed = 1;
+            vga_set_sink(saved);
+            copy_trimmed(out, out, capture.len, PIPE_BUF_SIZE);
+            piped = out;
+            p = bar + 1;
+            continue;
+        }
+
+        if (!redirect) return (execute_command(stage) != 0 || failed) ? -1 : 0;
+
+        int append = redirect[1] == '>';
+        char filename[RAMDISK_FILENAME_MAX];
+        const char *name = redirect + (append ? 2 : 1);
+        int name_len = copy_trimmed(filename, name, kstrlen(name), RAMDISK_FILENAME_MAX);
+        if (name_len <= 0 || kstrchr(filename, '>') || kstrchr(filename, ' ')) {
+            print_error("Invalid redirection target\n");
+            return -1;
+        }
+        file_sink_t target = { NULL, 0, 0 };
+        target.file = open_redirect(filename, append, &target.offset);
+        if (!target.file) {
+            print_error("Cannot open redirection target\n");
+            return -1;
+        }
+        vga_sink_t sink = { file_write, &target };
+        saved = vga_set_sink(sink);
+        if (execute_command(stage) != 0) failed = 1;
+        vga_set_sink(saved);
+        if (target.overflow) {
+            print_error("Output truncated: file is full\n");
+            failed = 1;
+        }
+        return failed ? -1 : 0;
+    }
+}
+
+int shell_execute(const char* cmd) {
+    int status;
+    if (cmd[0] == '\0') return 0;
+    if (kstrchr(cmd, '|') || kstrchr(cmd, '>')) {
+        status = execute_pipeline(cmd);
+        command_status = status;
+    } else {
+        status = execute_command(cmd);
+    }
+    vga_flush();
+    return status;
+}
+
+static int trie_new_node(char c) {
+    if (command_trie_nodes >= TRIE_MAX_NODES) return -1;
+    trie_node_t *node = &command_trie[command_trie_nodes];
+    node->c = c;
+    node->terminal = 0;
+    node->child = -1;
+    node->sibling = -1;
+    return command_trie_nodes++;
+}
+
+static void trie_insert(const char *word) {
+    int node = 0;
+    for (; *word; word++) {
+        int16_t *link = &command_trie[node].child;
+        while (*link >= 0 && command_trie[*link].c < *word) link = &command_trie[*link].sibling;
+        if (*link < 0 || command_trie[*link].c != *word) {
+            int child = trie_new_node(*word);
+            if (child < 0) return;
+            command_trie[child].sibling = *link;
+            *link = (int16_t)child;
+        }
+        node = *link;
+    }
+    command_trie[node].terminal = 1;
+}
+
+static void build_command_trie(void) {
+    command_trie_nodes = 0;
+    trie_new_node('\0');
+    for (int i = 0; commands[i].name != NULL; i++) trie_insert(commands[i].name);
+}
+
+static void trie_list(int node, char *path, int depth) {
+    if (command_trie[node].terminal) {
+        path[depth] = '\0';
+        print(path);
+        print("  ");
+    }
+    if (depth >= INPUT_BUF_SIZE - 1) return;
+    for (int child = command_trie[node].child; child >= 0; child = command_trie[child].sibling) {
+        path[depth] = command_trie[child].c;
+        trie_list(child, path, depth + 1);
+    }
+}
+
+static void complete_list_begin(void) {
+    set_cursor_pos(prompt_start_vga_pos + line.len);
+    putchar('\n');
+}
+
+static void complete_list_end(void) {
+    if (get_cursor() % get_screen_width() != 0) putchar('\n');
+    print_prompt();
+    prompt_start_vga_pos = get_cursor();
+    line.shown = 0;
+    editor_redraw_from(0);
+}
+
+static void complete_command(const char *prefix, int len) {
+    int node = 0;
+    for (int i = 0; i < len && node >= 0; i++) {
+        int child = command_trie[node].child;
+        while (child >= 0 && command_trie[child].c != prefix[i]) child = command_trie[child].sibling;
+        node = child;
+    }
+    if (node < 0) return;
+
+    char extension[INPUT_BUF_SIZE];
+    int count = 0;
+    while (!command_trie[node].terminal && command_trie[node].child >= 0 &&
+           command_trie[command_trie[node].child].sibling < 0) {
+        node = command_trie[node].child;
+        extension[count++] = command_trie[node].c;
+    }
+    if (command_trie[node].terminal && command_trie[node].child < 0) {
+        extension[count++] = ' ';
+        editor_insert_text(extension, count);
+    } else if (count > 0) {
+        editor_insert_text(extension, count);
+    } else {
+        char path[INPUT_BUF_SIZE];
+        kstrncpy(path, prefix, (size_t)len);
+        complete_list_begin();
+        trie_list(node, path, len);
+        complete_list_end();
+    }
+}
+
+static void complete_name_callback(const char *name, uint32_t inode) {
+    (void)inode;
+    if (kstrcmp(name, "/") == 0) return;
+    if (kstrncmp(name, complete_prefix, complete_prefix_len) != 0) return;
+    if (complete_listing) {
+        print(name);
+        print("  ");
+        return;
+    }
+    if (complete_matches == 0) {
+        kstrcpy(complete_common, name);
+    } else {
+        size_t i = 0;
+        while (complete_common[i] && complete_common[i] == name[i]) i++;
+        complete_common[i] = '\0';
+    }
+    complete_matches++;
+}
+
+static void complete_name(const char *prefix, int len) {
+    ramdisk_inode_t *dir = ramdisk_iget(current_dir_inode_no);
+    if (!dir) return;
+    complete_prefix = prefix;
+    complete_prefix_len = (size_t)len;
+    complete_matches = 0;
+    complete_listing = 0;
+    ramdisk_readdir(dir, complete_name_callback);
+    if (complete_matches == 0) return;
+
+    char extension[RAMDISK_FILENAME_MAX + 1];
+    int count = (int)kstrlen(complete_common) - len;
+    kstrcpy(extension, complete_common + len);
+    if (complete_matches == 1) {
+        extension[count++] = ' ';
+        editor_insert_text(extension, count);
+    } else if (count > 0) {
+        editor_insert_text(extension, count);
+    } else {
+        complete_list_begin();
+        complete_listing = 1;
+        ramdisk_readdir(dir, complete_name_callback);
+        complete_listing = 0;
+        complete_list_end();
+    }
+}
+
+static void complete(void) {
+    int start = line.cursor;
+    while (start > 0 && line.buf[start - 1] != ' ' && line.buf[start - 1] != '|' && line.buf[start - 1] != '>') start--;
+    int before = start;
+    while (before > 0 && line.buf[before - 1] == ' ') before--;
+    if (before == 0 || line.buf[before - 1] == '|') {
+        complete_command(line.buf + start, line.cursor - start);
+    } else {
+        complete_name(line.buf + start, line.cursor - start);
     }
 }
 
 void shell_run() {
-    char input[INPUT_BUF_SIZE] = {0};
-    int idx = 0;
-    int cursor_index = 0;
+    shell_consoles[active_shell_console].started = 1;
+    build_command_trie();
+    editor_reset();
     print_prompt();
     prompt_start_vga_pos = get_cursor();
     while (1) {
         int c = keyboard_getchar();
+        if (c == KEY_CTRL_R) {
+            c = reverse_search();
+        }
         if (c == KEY_NULL) {
             continue;
         }
+        if (c >= KEY_CONSOLE_1 && c <= KEY_CONSOLE_4) {
+            switch_console(c - KEY_CONSOLE_1);
+            continue;
+        }
         if (c == KEY_LEFT) {
-            if (cursor_index > 0) {
-                cursor_index--;
-                set_cursor_pos(prompt_start_vga_pos + cursor_index);
+            if (line.cursor > 0) {
+                line.cursor--;
+                editor_sync_cursor();
             }
             continue;
         }
         if (c == KEY_RIGHT) {
-            if (cursor_index < idx) {
-                cursor_index++;
-                set_cursor_pos(prompt_start_vga_pos + cursor_index);
+            if (line.cursor < line.len) {
+                line.cursor++;
+                editor_sync_cursor();
             }
             continue;
         }
+        if (c == KEY_CTRL_LEFT) {
+            line.cursor = editor_word_left();
+            editor_sync_cursor();
+            continue;
+        }
+        if (c == KEY_CTRL_RIGHT) {
+            line.cursor = editor_word_right();
+            editor_sync_cursor();
+            continue;
+        }
         if (c == KEY_UP) {
-            if (history_count == 0) continue;
-            if (history_view_pos == -1) history_view_pos = history_count - 1;
+            if (history_count() == 0) continue;
+            if (history_view_pos == -1) history_view_pos = history_count() - 1;
             else if (history_view_pos > 0) history_view_pos--;
-            load_history_line(input, &idx, &cursor_index, history_view_pos);
+            load_history_line(history_view_pos);
             continue;
         }
         if (c == KEY_DOWN) {
-            if (history_count == 0) continue;
+            if (history_count() == 0) continue;
             if (history_view_pos == -1) continue;
-            if (history_view_pos < history_count - 1) {
+            if (history_view_pos < history_count() - 1) {
                 history_view_pos++;
-                load_history_line(input, &idx, &cursor_index, history_view_pos);
+                load_history_line(history_view_pos);
             } else {
-                clear_input_line(get_screen_width());
-                idx = 0;
-                cursor_index = 0;
-                input[0] = '\0';
-                set_cursor_pos(prompt_start_vga_pos);
+                editor_set("");
                 history_view_pos = -1;
             }
             continue;
         }
-        if (c == KEY_HOME) {
-            cursor_index = 0;
-            set_cursor_pos(prompt_start_vga_pos + cursor_index);
+        if (c == KEY_HOME || c == KEY_CTRL_A) {
+            line.cursor = 0;
+            editor_sync_cursor();
             continue;
         }
-        if (c == KEY_END) {
-            cursor_index = idx;
-            set_cursor_pos(prompt_start_vga_pos + cursor_index);
+        if (c == KEY_END || c == KEY_CTRL_E) {
+            line.cursor = line.len;
+            editor_sync_cursor();
             continue;
         }
         if (c == KEY_ENTER) {
-            input[idx] = '\0';
+            line.buf[line.len] = '\0';
+            set_cursor_pos(prompt_start_vga_pos + line.len);
             putchar('\n');
-            add_history(input);
-            shell_execute(input);
+            add_history(line.buf);
+            shell_execute(line.buf);
             if (get_cursor() % get_screen_width() != 0) {
                 putchar('\n');
             }
-            idx = 0;
-            cursor_index = 0;
-            input[0] = '\0';
+            editor_reset();
             print_prompt();
             prompt_start_vga_pos = get_cursor();
             continue;
         }
         if (c == KEY_BACKSPACE) {
-            if (cursor_index > 0) {
-                for (int i = cursor_index - 1; i < idx; i++) {
-                    input[i] = input[i + 1];
-                }
-                idx--;
-                cursor_index--;
-                input[idx] = '\0';
-                clear_input_line(get_screen_width());
-                set_cursor_pos(prompt_start_vga_pos);
-                print(input);
-                set_cursor_pos(prompt_start_vga_pos + cursor_index);
-            }
+            if (line.cursor > 0) editor_delete(line.cursor - 1, 1);
             continue;
         }
         if (c == KEY_DELETE) {
-            if (cursor_index < idx) {
-                for (int i = cursor_index; i < idx; i++) {
-                    input[i] = input[i + 1];
-                }
-                idx--;
-                input[idx] = '\0';
-                clear_input_line(get_screen_width());
-                set_cursor_pos(prompt_start_vga_pos);
-                print(input);
-                set_cursor_pos(prompt_start_vga_pos + cursor_index);
-            }
+            if (line.cursor < line.len) editor_delete(line.cursor, 1);
+            continue;
+        }
+        if (c == KEY_CTRL_W) {
+            int start = editor_word_left();
+            editor_delete(start, line.cursor - start);
+            continue;
+        }
+        if (c == KEY_CTRL_DELETE) {
+            editor_delete(line.cursor, editor_word_right() - line.cursor);
+            continue;
+        }
+        if (c == KEY_TAB) {
+            complete();
             continue;
         }
-        if (idx < INPUT_BUF_SIZE - 1 && c >= 32 && c <= 126) {
-            for (int i = idx; i > cursor_index; i--) input[i] = input[i - 1];
-            input[cursor_index] = (char)c;
-            idx++;
-            cursor_index++;
-            input[idx] = '\0';
-            clear_input_line(get_screen_width());
-            set_cursor_pos(prompt_start_vga_pos);
-            print(input);
-            set_cursor_pos(prompt_start_vga_pos + cursor_index);
+        if (c >= 32 && c <= 126) {
+            editor_insert((char)c);
         }
     }
 }
@@ -19,10 +19,28 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include <stddef.h>
+
 #define MAX_CMD_LEN 256
 
+#define SHELL_SCRIPT_STOP_ON_ERROR 0x01
+#define SHELL_SCRIPT_QUIET         0x02
+#define SHELL_SCRIPT_ECHO          0x04
+
+typedef struct {
+    int ran;
+    int failed;
+    int failed_line;
+} shell_script_result_t;
+
 void shell_run(void);
-void shell_execute(const char* cmd);
+int shell_execute(const char* cmd);
+int shell_run_script(const char *script, size_t len, int flags, shell_script_result_t *result);
+
+/* vga_error_begin/vga_error_end for shell commands; shell_error_end also
+ * marks the running command as failed. */
+void shell_error_begin(void);
+void shell_error_end(void);
 
 extern const char* banner_ansi;
 
@@ -0,0 +1,226 @@
+/*
+ * cheeseDOS - My x86 DOS
+ * Copyright (C) 2025  Connor Thomson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "kprintf.h"
+#include "div64.h"
+#include "vga.h"
+
+#define KPRINTF_BUF_SIZE 256
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    int total;
+    int console;
+} kprintf_out_t;
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+/* Console output is buffered and written in as few vga_write calls as the
+ * buffer allows; string output silently truncates but keeps counting. */
+static void out_char(kprintf_out_t *out, char c) {
+    out->total++;
+    if (out->console) {
+        if (out->len == out->size) {
+            vga_write(out->buf, out->len);
+            out->len = 0;
+        }
+    } else if (out->len + 1 >= out->size) {
+        return;
+    }
+    out->buf[out->len++] = c;
+}
+
+static void out_repeat(kprintf_out_t *out, char c, int count) {
+    while (count-- > 0) out_char(out, c);
+}
+
+/* Writes the decimal digits of value ending at end, two at a time. */
+static char *format_u32(char *end, uint32_t value) {
+    while (value >= 100) {
+        uint32_t q = value / 100;
+        const char *pair = &digit_pairs[(value - q * 100) * 2];
+        *--end = pair[1];
+        *--end = pair[0];
+        value = q;
+    }
+    if (value >= 10) {
+        *--end = digit_pairs[value * 2 + 1];
+        *--end = digit_pairs[value * 2];
+    } else {
+        *--end = (char)('0' + value);
+    }
+    return end;
+}
+
+static char *format_u64(char *end, uint64_t value) {
+    while (value > 0xFFFFFFFFULL) {
+        uint32_t chunk;
+        value = udiv64_32(value, 1000000000, &chunk);
+        char *start = format_u32(end, chunk);
+        while (end - start < 9) *--start = '0';
+        end = start;
+    }
+    return format_u32(end, (uint32_t)value);
+}
+
+static char *format_hex(char *end, uint64_t value, const char *digits) {
+    do {
+        *--end = digits[value & 0xF];
+        value >>= 4;
+    } while (value);
+    return end;
+}
+
+static void out_field(kprintf_out_t *out, const char *text, int len, int width,
+                      int left, char pad, int negative) {
+    int fill = width - len - negative;
+    if (negative && pad == '0') out_char(out, '-');
+    if (!left) out_repeat(out, pad, fill);
+    if (negative && pad != '0') out_char(out, '-');
+    for (int i = 0; i < len; i++) out_char(out, text[i]);
+    if (left) out_repeat(out, ' ', fill);
+}
+
+static void format(kprintf_out_t *out, const char *fmt, va_list args) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            out_char(out, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        int left = 0;
+        char pad = ' ';
+        int width = 0;
+        int longs = 0;
+
+        for (;; fmt++) {
+            if (*fmt == '-') left = 1;
+            else if (*fmt == '0') pad = '0';
+            else break;
+        }
+        if (*fmt == '*') {
+            width = va_arg(args, int);
+            fmt++;
+        }
+        while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+        while (*fmt == 'l') {
+            longs++;
+            fmt++;
+        }
+        if (left) pad = ' ';
+
+        char *start;
+        int negative = 0;
+        switch (*fmt) {
+            case 'd':
+            case 'i': {
+                int64_t value = longs >= 2 ? va_arg(args, int64_t) : va_arg(args, int32_t);
+                uint64_t magnitude = (uint64_t)value;
+                if (value < 0) {
+                    negative = 1;
+                    magnitude = 0 - magnitude;
+                }
+                start = format_u64(end, magnitude);
+                out_field(out, start, (int)(end - start), width, left, pad, negative);
+                break;
+            }
+            case 'u': {
+                uint64_t value = longs >= 2 ? va_arg(args, uint64_t) : va_arg(args, uint32_t);
+                start = format_u64(end, value);
+                out_field(out, start, (int)(end - start), width, left, pad, 0);
+                break;
+            }
+            case 'x':
+            case 'X': {
+                uint64_t value = longs >= 2 ? va_arg(args, uint64_t) : va_arg(args, uint32_t);
+                start = format_hex(end, value, *fmt == 'x' ? hex_lower : hex_upper);
+                out_field(out, start, (int)(end - start), width, left, pad, 0);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(args, const char *);
+                int len = 0;
+                if (!s) s = "(null)";
+                while (s[len]) len++;
+                out_field(out, s, len, width, left, ' ', 0);
+                break;
+            }
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                out_field(out, &c, 1, width, left, ' ', 0);
+                break;
+            }
+            case '%':
+                out_char(out, '%');
+                break;
+            case '\0':
+                return;
+            default:
+                out_char(out, '%');
+                out_char(out, *fmt);
+                break;
+        }
+        fmt++;
+    }
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    kprintf_out_t out = { buf, size, 0, 0, 0 };
+    format(&out, fmt, args);
+    if (size > 0) buf[out.len] = '\0';
+    return out.total;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int total = kvsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return total;
+}
+
+int kprintf(const char *fmt, ...) {
+    char buf[KPRINTF_BUF_SIZE];
+    kprintf_out_t out = { buf, sizeof(buf), 0, 0, 1 };
+    va_list args;
+    va_start(args, fmt);
+    format(&out, fmt, args);
+    va_end(args);
+    vga_write(buf, out.len);
+    return out.total;
+}